@@ -7,26 +7,68 @@
 
 
 
+// Boa³² microcontroller with one or more harts.
+// Each hart has its own caches; the harts share the boot ROM, internal RAM, peripherals and external memory.
+// The data caches are not coherent, so data shared between harts should be in the internal RAM,
+// or be written back and invalidated with cache-block operations. LR/SC and AMOs work across harts in the internal RAM.
 module main#(
     // ROM image file.
     parameter string  rom_file          = "",
+    // Internal RAM image file.
+    parameter string  ram_file          = "",
+    // CPU entrypoint address.
+    parameter integer entrypoint        = 32'h4000_0000,
     // UART buffer size.
     parameter integer uart_buf          = 16,
     // Default UART clock divider.
     parameter integer uart_div          = 1250,
     // Whether we're running in the simulator.
     parameter bit     is_simulator      = 0,
+    // Number of harts, at least 1.
+    parameter integer harts             = 1,
     
     // Divider latency.
     parameter integer div_latency       = 2,
     // Divider distribution, "begin", "end", "center" or "all".
     parameter integer div_distr         = "center",
+    // Use an iterative divider instead of the pipelined one.
+    parameter bit     div_iterative     = 0,
+    // Iterative divider radix, 2 or 4.
+    parameter integer div_radix         = 4,
     // Multiplier latency.
     parameter integer mul_latency       = 1,
     // Enable additional latch in IF branch address.
     parameter bit     if_branch_reg     = 0,
+    // Number of 4-byte words in the IF L0 instruction buffer, 0 to disable.
+    parameter integer l0_depth          = 32,
+    // Number of branch target buffer entries, 0 to disable.
+    parameter integer btb_depth         = 16,
+    // Number of return address stack entries, 0 to disable.
+    parameter integer ras_depth         = 4,
+    // Number of branch history table entries, 0 for static prediction.
+    parameter integer bht_depth         = 64,
+    // Number of global history bits hashed into the branch history table index.
+    parameter integer bht_history       = 0,
     // Enable additional latch for RMW AMOs.
     parameter bit     rmw_amo_reg       = 0,
+    // Number of store buffer entries, 0 to disable.
+    parameter integer sbuf_depth        = 4,
+    // Support misaligned loads and stores in hardware.
+    parameter bit     misaligned        = 1,
+    // Support the cycle, time and instret counters.
+    parameter bit     has_zicntr        = 1,
+    // Number of hardware performance event counters.
+    parameter integer hpm_counters      = 4,
+    // Support cache-block management instructions.
+    parameter bit     has_zicbom        = 1,
+    // Support cache-block prefetch hints.
+    parameter bit     has_zicbop        = 1,
+    // Support address generation instructions.
+    parameter bit     has_zba           = 1,
+    // Support basic bit-manipulation instructions.
+    parameter bit     has_zbb           = 1,
+    // Support single-bit instructions.
+    parameter bit     has_zbs           = 1,
     
     // Number of address bits for the internal memory, at least 16.
     parameter integer bram_alen         = 16,
@@ -50,6 +92,28 @@ module main#(
     parameter integer dcache_lines      = 32,
     // Number of 4-byte words per data cache line.
     parameter integer dcache_line_size  = 16,
+    // Cache replacement policy, "rr", "plru" or "lru".
+    parameter string  cache_repl        = "plru",
+    // Whether caches fill lines critical word first.
+    parameter bit     cache_cwf         = 1,
+    // Number of cache miss status holding registers, 0, 1 or 2.
+    parameter integer cache_mshrs       = 2,
+    // Whether the data cache writes back evicted lines through a victim buffer.
+    parameter bit     dcache_victim_buf = 1,
+    // Whether caches transfer lines to and from extmem as bursts.
+    parameter bit     cache_burst       = 1,
+    // Data bus size between the caches and extmem, 32 or 64; extrom_bus and extram_bus must match.
+    parameter integer xm_dlen           = 32,
+    // Arbitration method between the caches for extmem, one of the BOA_ARBITER_* values.
+    parameter integer xm_arbiter        = `BOA_ARBITER_RR,
+    // Whether extmem arbitration picks the next cache one cycle in advance.
+    parameter bit     xm_arb_pipelined  = 0,
+    // Length of the extmem bandwidth cap window in cycles, 0 to disable bandwidth caps.
+    parameter integer xm_bw_window      = 0,
+    // Maximum number of extmem accesses per window by each instruction cache, 0 for no limit.
+    parameter integer icache_bw_cap     = 0,
+    // Maximum number of extmem accesses per window by each data cache, 0 for no limit.
+    parameter integer dcache_bw_cap     = 0,
     
     // Number of PMP entries, 0, 16 or 64.
     parameter integer pmp_depth         = 16,
@@ -96,70 +160,207 @@ module main#(
     pmu_bus.CPU         pmb
 );
     `include "boa_fileio.svh"
+    genvar h;
     
     // Memory buses.
-    boa_mem_bus cpu_ibus();
-    boa_mem_bus cpu_dbus();
-    boa_mem_bus cache_ibus();
-    boa_mem_bus cache_dbus();
-    boa_mem_bus xm_ibus();
-    boa_mem_bus xm_dbus();
-    boa_mem_bus ibus[3]();
-    boa_mem_bus dbus[4]();
-    boa_mem_bus#(12) peri_bus[14]();
+    boa_mem_bus cpu_ibus[harts]();
+    boa_mem_bus cpu_dbus[harts]();
+    boa_mem_bus rom_ibus();
+    boa_mem_bus rom_dbus();
+    boa_mem_bus ram_ibus();
+    boa_mem_bus ram_dbus();
+    boa_mem_bus peri_dbus();
+    boa_mem_bus rom_ibuses[harts]();
+    boa_mem_bus rom_dbuses[harts]();
+    boa_mem_bus ram_ibuses[harts]();
+    boa_mem_bus ram_dbuses[harts]();
+    boa_mem_bus peri_dbuses[harts]();
+    boa_mem_bus#(12) peri_bus[16]();
     
     // Atomics signals.
-    logic       amo_rmw;
-    boa_amo_bus amo_bus();
-    boa_amo_term amo_term(amo_bus);
+    boa_amo_bus amo_bus[harts]();
+    generate
+        if (harts == 1) begin: amo_single
+            boa_amo_term amo_term(amo_bus[0]);
+        end else begin: amo_smp
+            // One reservation per hart; watches the data buses of all harts, so any write to a reserved word breaks that reservation.
+            boa_amo_ctl_n#(32, harts, harts, 2, 1) amo_ctl(clk, rst, amo_bus, cpu_dbus);
+        end
+    endgenerate
     
     // Program ROM.
-    dp_block_ram#(10, rom_file, 1) rom(clk, ibus[0], dbus[0]);
+    dp_block_ram#(10, rom_file, 1) rom(clk, rom_ibus, rom_dbus);
     // RAM.
-    dp_block_ram#(bram_alen-2, "", 0) ram(clk, ibus[1], dbus[1]);
-    // Instruction cache.
-    logic icache_flush_r, icache_flushing_r, icache_flushing_w, icache_stall;
-    boa_cache#(cache_alen, icache_line_size, icache_lines, icache_ways, 0) icache (
-        clk, rst,
-        icache_flush_r || fence_i, 0, 0, 0,
-        icache_flushing_r, icache_flushing_w, icache_stall,
-        cache_ibus, xm_ibus
-    );
-    // Data cache.
-    logic dcache_flush_r, dcache_flush_w, dcache_flushing_r, dcache_flushing_w;
-    boa_cache#(cache_alen, dcache_line_size, dcache_lines, dcache_ways, 1) dcache (
-        clk, rst,
-        dcache_flush_r, dcache_flush_w, 0, 0,
-        dcache_flushing_r, dcache_flushing_w, 0,
-        cache_dbus, xm_dbus
-    );
+    dp_block_ram#(bram_alen-2, ram_file, 0) ram(clk, ram_ibus, ram_dbus);
+    
+    // Connections shared between the harts.
+    logic[7:0] no_caps[harts];
+    generate
+        for (h = 0; h < harts; h = h + 1) begin
+            assign no_caps[h] = 0;
+        end
+        if (harts == 1) begin: single
+            boa_mem_connector rom_iconn(rom_ibus, rom_ibuses[0]);
+            boa_mem_connector rom_dconn(rom_dbus, rom_dbuses[0]);
+            boa_mem_connector ram_iconn(ram_ibus, ram_ibuses[0]);
+            boa_mem_connector ram_dconn(ram_dbus, ram_dbuses[0]);
+            boa_mem_connector peri_conn(peri_dbus, peri_dbuses[0]);
+        end else begin: smp
+            boa_mem_demux#(32, 32, harts) rom_idemux(clk, rst, rom_ibuses, rom_ibus, no_caps);
+            boa_mem_demux#(32, 32, harts) rom_ddemux(clk, rst, rom_dbuses, rom_dbus, no_caps);
+            boa_mem_demux#(32, 32, harts) ram_idemux(clk, rst, ram_ibuses, ram_ibus, no_caps);
+            boa_mem_demux#(32, 32, harts) ram_ddemux(clk, rst, ram_dbuses, ram_dbus, no_caps);
+            boa_mem_demux#(32, 32, harts) peri_demux(clk, rst, peri_dbuses, peri_dbus, no_caps);
+        end
+    endgenerate
     
-    // External memory connections.
-    boa_mem_cmap#(31, 1, cache_alen-1) icmap(ibus[2], cache_ibus);
-    boa_mem_cmap#(31, 1, cache_alen-1) dcmap(dbus[2], cache_dbus);
-    boa_mem_bus#(cache_alen) cache_buses[2]();
-    boa_mem_bus#(cache_alen) xm_buses[2]();
-    boa_mem_connector cxconn0(cache_buses[0], xm_ibus);
-    boa_mem_connector cxconn1(cache_buses[1], xm_dbus);
+    // External memory connections; the caches of hart h are xbar ports 2h and 2h+1.
+    boa_mem_bus#(cache_alen, xm_dlen) cache_buses[2*harts]();
+    boa_mem_bus#(cache_alen, xm_dlen) xm_buses[2]();
     boa_mem_connector cxconn2(extrom_bus, xm_buses[0]);
     boa_mem_connector cxconn3(extram_bus, xm_buses[1]);
+    // Bandwidth caps only apply while another cache is waiting.
+    logic[7:0] xm_caps[2*harts];
     boa_mem_xbar#(
-        cache_alen, 32, 2, 2, `BOA_ARBITER_STATIC
+        cache_alen, xm_dlen, 2*harts, 2, xm_arbiter, xm_arb_pipelined, xm_bw_window
     ) xbar (
         clk, rst,
         cache_buses, xm_buses,
         {32'h8000_0000, 32'hc000_0000},
-        {extrom_alen,   extram_alen}
+        {extrom_alen,   extram_alen},
+        xm_caps
     );
     
-    // Cache flushing logic.
-    assign dcache_flush_r = fence_aq;
-    assign dcache_flush_w = fence_aq || fence_rl;
-    assign icache_flush_r = fence_i;
-    assign icache_stall   = dcache_flushing_w;
+    // Fence signals of each hart.
+    logic[harts-1:0] hart_fence_rl, hart_fence_aq, hart_fence_i;
+    assign fence_rl = hart_fence_rl != 0;
+    assign fence_aq = hart_fence_aq != 0;
+    assign fence_i  = hart_fence_i  != 0;
     
-    // UART.
+    // Machine software interrupts.
+    logic[harts-1:0] msip;
+    // Interrupts shared between the harts, routed to hart 0.
     logic rx_full, tx_empty;
+    
+    generate
+        for (h = 0; h < harts; h = h + 1) begin: hart
+            // Memory buses.
+            boa_mem_bus cache_ibus();
+            boa_mem_bus cache_dbus();
+            boa_mem_bus#(32, xm_dlen) xm_ibus();
+            boa_mem_bus#(32, xm_dlen) xm_dbus();
+            boa_mem_bus ibus[3]();
+            boa_mem_bus dbus[4]();
+            
+            // Instruction cache.
+            // With one hart, snoops data cache writes so that FENCE.I only invalidates the lines that were written to.
+            // With more harts, code may have been written through another hart's data cache, so FENCE.I invalidates everything.
+            logic icache_flush_r, icache_flushing_r, icache_flushing_w, icache_dirty, icache_stall, icache_miss;
+            boa_cache#(cache_alen, icache_line_size, icache_lines, icache_ways, 0, cache_repl, cache_cwf, cache_mshrs, 0, harts == 1, cache_burst, xm_dlen) icache (
+                clk, rst,
+                icache_flush_r, 0, 0, 0, 0,
+                cache_dbus.we != 0, cache_dbus.addr[cache_alen-1:2],
+                icache_flushing_r, icache_flushing_w, icache_dirty, icache_stall, icache_miss,
+                cache_ibus, xm_ibus
+            );
+            // Data cache.
+            logic dcache_flush_r, dcache_flush_w, dcache_pi_en, dcache_prefetch, dcache_flushing_r, dcache_flushing_w, dcache_dirty, dcache_miss;
+            logic[cache_alen-1:2] dcache_pi_addr;
+            boa_cache#(cache_alen, dcache_line_size, dcache_lines, dcache_ways, 1, cache_repl, cache_cwf, cache_mshrs, dcache_victim_buf, 0, cache_burst, xm_dlen) dcache (
+                clk, rst,
+                dcache_flush_r, dcache_flush_w, dcache_pi_en, dcache_pi_addr, dcache_prefetch,
+                0, 0,
+                dcache_flushing_r, dcache_flushing_w, dcache_dirty, 0, dcache_miss,
+                cache_dbus, xm_dbus
+            );
+            
+            // External memory connections.
+            boa_mem_cmap#(31, 1, cache_alen-1) icmap(ibus[2], cache_ibus);
+            boa_mem_cmap#(31, 1, cache_alen-1) dcmap(dbus[2], cache_dbus);
+            boa_mem_connector cxconn0(cache_buses[2*h], xm_ibus);
+            boa_mem_connector cxconn1(cache_buses[2*h+1], xm_dbus);
+            assign xm_caps[2*h]   = icache_bw_cap;
+            assign xm_caps[2*h+1] = dcache_bw_cap;
+            
+            // Cache flushing logic.
+            // Fences only write back dirty lines; cache-block operations only apply to the cached address range.
+            // FENCE.I writes back the data cache and invalidates the instruction cache (with one hart, only the lines written to since the last FENCE.I),
+            // the instruction cache does not fetch from extmem until the write-back is done.
+            logic       cmo_inval, cmo_clean, cmo_prefetch;
+            logic[31:0] cmo_addr;
+            wire        cmo_cached      = cmo_addr[31];
+            assign dcache_flush_r   = cmo_inval && cmo_cached;
+            assign dcache_flush_w   = hart_fence_aq[h] || hart_fence_rl[h] || hart_fence_i[h] || cmo_clean && cmo_cached;
+            assign dcache_pi_en     = (cmo_inval || cmo_clean) && cmo_cached;
+            assign dcache_pi_addr   = {cmo_addr[31], cmo_addr[cache_alen-2:2]};
+            assign dcache_prefetch  = cmo_prefetch && cmo_cached;
+            assign icache_flush_r   = hart_fence_i[h];
+            assign icache_stall     = dcache_flushing_w;
+            // A data cache operation is in progress, or the CPU's request starts one: precise operations always do,
+            // a write-back only if the data cache may be dirty. FENCE.I is left out; the CPU sends nothing alongside it.
+            wire        cmo_busy        = dcache_flushing_r || dcache_flushing_w || dcache_pi_en
+                                        || (hart_fence_aq[h] || hart_fence_rl[h]) && dcache_dirty;
+            
+            // Memory interconnects.
+            boa_mem_mux#(.mems(3)) imux(clk, rst, cpu_ibus[h], ibus, {32'h4000_0000, 32'h5000_0000, 32'h8000_0000},                {12, bram_alen, 31});
+            boa_mem_mux#(.mems(4)) dmux(clk, rst, cpu_dbus[h], dbus, {32'h4000_0000, 32'h5000_0000, 32'h8000_0000, 32'h2000_0000}, {12, bram_alen, 31, 12});
+            boa_mem_connector rom_iconn(rom_ibuses[h], ibus[0]);
+            boa_mem_connector rom_dconn(rom_dbuses[h], dbus[0]);
+            boa_mem_connector ram_iconn(ram_ibuses[h], ibus[1]);
+            boa_mem_connector ram_dconn(ram_dbuses[h], dbus[1]);
+            boa_mem_connector peri_conn(peri_dbuses[h], dbus[3]);
+            
+            // CPU.
+            logic       amo_rmw;
+            logic[31:16] irq;
+            boa32_cpu#(
+                .entrypoint(entrypoint),
+                .cpummio(32'h3000_0000),
+                .hartid(h),
+                .debug(0),
+                .pmp_depth(pmp_depth),
+                .pmp_grain(pmp_grain),
+                .div_latency(div_latency),
+                .div_distr(div_distr),
+                .div_iterative(div_iterative),
+                .div_radix(div_radix),
+                .mul_latency(mul_latency),
+                .if_branch_reg(if_branch_reg),
+                .l0_depth(l0_depth),
+                .btb_depth(btb_depth),
+                .ras_depth(ras_depth),
+                .bht_depth(bht_depth),
+                .bht_history(bht_history),
+                .rmw_amo_reg(rmw_amo_reg),
+                .sbuf_depth(sbuf_depth),
+                .io_base(32'h2000_0000),
+                .io_bits(29),
+                .misaligned(misaligned),
+                .has_zicntr(has_zicntr),
+                .hpm_counters(hpm_counters),
+                .has_zicbom(has_zicbom),
+                .has_zicbop(has_zicbop),
+                .has_zba(has_zba),
+                .has_zbb(has_zbb),
+                .has_zbs(has_zbs)
+            ) cpu (
+                clk, rtc_clk, rst,
+                cpu_ibus[h], cpu_dbus[h],
+                hart_fence_rl[h], hart_fence_aq[h], hart_fence_i[h],
+                cmo_inval, cmo_clean, cmo_prefetch, cmo_addr, cmo_busy,
+                amo_rmw, amo_bus[h],
+                irq, msip[h],
+                icache_miss, dcache_miss
+            );
+            
+            // Interrupts.
+            assign irq[16] = h == 0 && tx_empty;
+            assign irq[17] = h == 0 && rx_full;
+            assign irq[31:18] = 0;
+        end
+    endgenerate
+    
+    // UART.
     boa_peri_uart#(.addr('h000), .tx_depth(uart_buf), .rx_depth(uart_buf), .init_div(uart_div)) uart(
         clk, rst, peri_bus[0], txd, rxd, tx_empty, rx_full
     );
@@ -185,36 +386,9 @@ module main#(
     boa_peri_readable#(.addr('h310)) is_sim(clk, rst, peri_bus[12], is_simulator);
     // External MMIO bus.
     boa_mem_connector xmp_conn(xmp_bus, peri_bus[13]);
-    
-    // Memory interconnects.
-    boa_mem_mux#(.mems(3)) imux(clk, rst, cpu_ibus, ibus, {32'h4000_0000, 32'h5000_0000, 32'h8000_0000},                {12, bram_alen, 31});
-    boa_mem_mux#(.mems(4)) dmux(clk, rst, cpu_dbus, dbus, {32'h4000_0000, 32'h5000_0000, 32'h8000_0000, 32'h2000_0000}, {12, bram_alen, 31, 12});
-    boa_mem_overlay#(.mems(14)) ovl(dbus[3], peri_bus);
-    
-    // CPU.
-    logic[31:16] irq;
-    boa32_cpu#(
-        .entrypoint(32'h4000_0000),
-        .cpummio(32'h3000_0000),
-        .hartid(0),
-        .debug(0),
-        .pmp_depth(pmp_depth),
-        .pmp_grain(pmp_grain),
-        .div_latency(div_latency),
-        .div_distr(div_distr),
-        .mul_latency(mul_latency),
-        .if_branch_reg(if_branch_reg),
-        .rmw_amo_reg(rmw_amo_reg)
-    ) cpu (
-        clk, rtc_clk, rst,
-        cpu_ibus, cpu_dbus,
-        fence_rl, fence_aq, fence_i,
-        amo_rmw, amo_bus,
-        irq
-    );
-    
-    // Interrupts.
-    assign irq[16] = tx_empty;
-    assign irq[17] = rx_full;
-    assign irq[31:18] = 0;
+    // Number of harts.
+    boa_peri_readable#(.addr('h320)) num_harts(clk, rst, peri_bus[14], harts);
+    // Machine software interrupts.
+    boa_peri_msip#(.addr('h700), .harts(harts)) msip_regs(clk, rst, peri_bus[15], msip);
+    boa_mem_overlay#(.mems(16)) ovl(peri_dbus, peri_bus);
 endmodule
@@ -7,6 +7,8 @@
 
 // Configurable cache intended for larger memories with longer access times.
 // Does not support coherency; it should not be used redundantly with other caches.
+// With snoop enabled, writes made elsewhere are reported on snoop_we and marked per line,
+// and flush_r then only invalidates the lines that were marked.
 module boa_cache#(
     // Number of address bits.
     parameter alen          = 24,
@@ -19,6 +21,23 @@ module boa_cache#(
     
     // Whether this cache supports write access.
     parameter writeable     = 1,
+    // Replacement policy: "rr" (round-robin), "plru" (tree pseudo-LRU) or "lru" (true LRU).
+    // Pseudo-LRU requires ways to be a power of 2, true LRU is intended for up to 4 ways.
+    parameter replacement   = "rr",
+    // Fill lines starting at the requested word and complete the access as soon as it arrives.
+    parameter cwf           = 0,
+    // Number of miss status holding registers, 0, 1 or 2.
+    // With 1 or more, reads that hit are served while a line is being filled.
+    // With 2, a clean miss that arrives during a line fill is started as soon as that fill completes.
+    parameter mshrs         = 0,
+    // Whether dirty lines evicted by a line fill are moved to a write-back buffer instead of being written to extmem first.
+    parameter victim_buf    = 0,
+    // Whether to track lines written to through snoop_we, so flush_r only invalidates those lines.
+    parameter snoop         = 0,
+    // Whether line fills and write-backs are issued to extmem as bursts; only used with at most 16 extmem words per line.
+    parameter burst         = 0,
+    // Extmem data bus size, 32 or 64; a line must be at least 2 extmem words.
+    parameter xm_dlen       = 32,
     
     // Number of bits required to address a 4-byte word in a line.
     localparam lswidth      = $clog2(line_size),
@@ -31,7 +50,17 @@ module boa_cache#(
     // Number of bits required to address a line.
     localparam lwidth       = $clog2(lines),
     // Number of bits required to store a cache tag.
-    localparam twidth       = alen-tgrain+2
+    localparam twidth       = alen-tgrain+2,
+    // Number of bits required to store the replacement state of a line.
+    localparam rwidth       = replacement == "lru" ? ways*wwidth : replacement == "plru" ? ways-1 : wwidth,
+    // Number of 4-byte words per extmem word.
+    localparam xw           = xm_dlen / 32,
+    // Number of bits required to address a 4-byte word in an extmem word.
+    localparam xwbits       = $clog2(xw),
+    // Granularity of extmem addresses.
+    localparam xgrain       = xwbits+2,
+    // Burst length minus one for extmem line transfers.
+    localparam xm_blen      = burst && line_size/xw <= 16 ? line_size/xw-1 : 0
 )(
     // CPU clock.
     input  logic            clk,
@@ -46,15 +75,26 @@ module boa_cache#(
     
     // Precise invalidation enable.
     input  logic            pi_en,
-    // Precise invalidation address.
+    // Precise invalidation or prefetch address.
     input  logic[alen-1:2]  pi_addr,
+    // Prefetch the line containing pi_addr once the cache is idle.
+    input  logic            prefetch,
+    
+    // A write to snoop_addr was made without going through this cache.
+    input  logic            snoop_we,
+    // Address of the snooped write.
+    input  logic[alen-1:2]  snoop_addr,
     
     // Currently flushing the cache.
     output logic            flushing_r,
     // Currently flushing writes.
     output logic            flushing_w,
+    // Lines may have been written to since they were last written back, so flush_w would start a write-back.
+    output logic            dirty,
     // Stall any access requests.
     input  logic            stall,
+    // An access missed and a line fill was started.
+    output logic            miss,
     
     // Cache interface.
     boa_mem_bus.MEM         bus,
@@ -69,22 +109,42 @@ module boa_cache#(
     logic               fl_w;
     // Doing a precise invalidation.
     logic               fl_pi;
+    // Tag read for the first invalidation operation is done.
+    logic               fl_rdy;
     // Line to flush next.
     logic[lwidth-1:0]   fl_line;
     // Way to flush next.
     logic[wwidth-1:0]   fl_way;
     // Precise invalidation address.
     logic[alen-1:2]     fl_addr;
-    // This is the last invalidation operation.
-    wire                fl_end = fl_pi || (fl_way == ways-1 && fl_line == lines-1);
+    // Imprecise invalidation visits every line instead of only the ones marked in fl_dirty.
+    logic               fl_all;
+    // Lines that may have been written to, here or through snoop_we, since they were last flushed.
+    logic[lines-1:0]    fl_dirty;
+    // Prefetch waiting for the cache to become idle.
+    logic               pf_valid;
+    // Address to prefetch.
+    logic[alen-1:2]     pf_addr;
     
     
     // A tag has an address to map to external memory and a few flags.
     // The address truncates the bottom `tgrain` bits from an `alen`-bit address.
     // The valid flag indicates the cache entry contains valid data.
     // The dirty flag indicates the cache entry was written to but not flushed.
-    // In addition to a number of ways, a cache line also contains the index of the "oldest" way.
-    // This index is incremented every time a line is fetched from extmem and used as an index for which way to evict.
+    // In addition to a number of ways, a cache line also contains the replacement state, which selects the way to evict.
+    // For round-robin, this is the index of the "oldest" way, incremented every time a line is fetched from extmem.
+    // For pseudo-LRU and LRU, the state is also updated on every hit.
+    // With cwf, a line fill starts at the word that missed and wraps around the line.
+    // A read that missed completes as soon as its word arrives, while the rest of the line is filled in the background.
+    // With mshrs, reads to other resident lines and to words of the filling line that already arrived are also served during a fill.
+    // With a 64-bit extmem bus, cache memory stores two words per entry, so line transfers move two words per cycle.
+    // Word indices used by line transfers then advance by two and stay aligned to the extmem word.
+    // With victim_buf, a dirty victim is copied to the write-back buffer alongside the line fill, ahead of the words being filled.
+    // The buffer is drained to extmem after the fill; until then, reads to the evicted line are served from the buffer.
+    // An invalidation visits one way per cycle; a dirty way is written back first and then visited again.
+    // Flushing only writes skips lines that have not been written to since they were last flushed.
+    // A prefetch takes the place of an access when both the cache and the bus are idle.
+    // It is a hint; it is dropped if the cache is busy by then or if it would have to write back a dirty line first.
     
     // Access buffer.
     logic           ab_re;
@@ -92,21 +152,24 @@ module boa_cache#(
     logic[alen-1:2] ab_addr;
     logic[31:0]     ab_wdata;
     logic           ab_stall;
+    logic           ab_pf;
+    logic           pf_inject;
     always @(posedge clk) begin
-        ab_re       <= rst               ? 0 : bus.re;
+        ab_re       <= rst               ? 0 : bus.re || pf_inject;
         ab_we       <= rst || !writeable ? 0 : bus.we;
-        ab_addr     <= bus.addr;
+        ab_addr     <= pf_inject ? pf_addr : bus.addr;
         ab_wdata    <= bus.wdata;
         ab_stall    <= stall;
+        ab_pf       <= !rst && pf_inject;
     end
     
     // Tag storage.
     logic                           tag_we;
     logic[lwidth-1:0]               tag_waddr;
-    logic[twidth*ways+wwidth-1:0]   tag_wdata;
+    logic[twidth*ways+rwidth-1:0]   tag_wdata;
     logic[lwidth-1:0]               tag_raddr;
-    logic[twidth*ways+wwidth-1:0]   tag_rdata;
-    raw_sdp_block_ram#(lwidth, 1, twidth*ways+wwidth, "", 1) tag_ram(
+    logic[twidth*ways+rwidth-1:0]   tag_rdata;
+    raw_sdp_block_ram#(lwidth, 1, twidth*ways+rwidth, "", 1) tag_ram(
         clk, tag_we, tag_waddr, tag_wdata, tag_raddr, tag_rdata
     );
     
@@ -114,8 +177,8 @@ module boa_cache#(
     logic                   rtag_valid[ways];
     logic                   rtag_dirty[ways];
     logic[alen-1:tgrain]    rtag_addr [ways];
-    logic[wwidth-1:0]       rtag_wnext;
-    assign rtag_wnext = tag_rdata[twidth*ways+wwidth-1:twidth*ways];
+    logic[rwidth-1:0]       rtag_repl;
+    assign rtag_repl = tag_rdata[twidth*ways+rwidth-1:twidth*ways];
     generate
         for (x = 0; x < ways; x = x + 1) begin
             assign rtag_valid[x]                = tag_rdata[twidth*x+alen-tgrain-1+2];
@@ -128,8 +191,8 @@ module boa_cache#(
     logic                   wtag_valid[ways];
     logic                   wtag_dirty[ways];
     logic[alen-1:tgrain]    wtag_addr [ways];
-    logic[wwidth-1:0]       wtag_wnext;
-    assign tag_wdata[twidth*ways+wwidth-1:twidth*ways] = wtag_wnext;
+    logic[rwidth-1:0]       wtag_repl;
+    assign tag_wdata[twidth*ways+rwidth-1:twidth*ways] = wtag_repl;
     generate
         for (x = 0; x < ways; x = x + 1) begin
             assign tag_wdata[twidth*x+alen-tgrain-1+2]        = wtag_valid[x];
@@ -162,8 +225,18 @@ module boa_cache#(
     assign tag_valid = masked_tag_valid != 0;
     assign tag_dirty = masked_tag_dirty != 0;
     
+    // Replacement policy.
+    logic[wwidth-1:0]       rtag_wnext;
+    logic[rwidth-1:0]       repl_init;
+    logic[rwidth-1:0]       repl_fill;
+    logic[rwidth-1:0]       repl_hit;
+    boa_cache_repl#(ways, replacement) repl(
+        rtag_repl, tag_way,
+        rtag_wnext, repl_init, repl_fill, repl_hit
+    );
+    
     // Tag encoder.
-    logic                   etag_way;
+    logic[wwidth-1:0]       etag_way;
     logic                   etag_valid;
     logic                   etag_dirty;
     logic[alen-tgrain-1:0]  etag_addr;
@@ -176,32 +249,35 @@ module boa_cache#(
     endgenerate
     
     
-    // Data storage.
-    logic[4*ways-1:0]           cache_we;
+    // Data storage; addresses are in words, the lowest xwbits of which select a word within an entry.
+    logic[4*xw*ways-1:0]        cache_we;
     logic[lwidth+lswidth-1:0]   cache_waddr;
-    logic[32*ways-1:0]          cache_wdata;
+    logic[xm_dlen*ways-1:0]     cache_wdata;
     logic[lwidth+lswidth-1:0]   cache_raddr;
-    logic[32*ways-1:0]          cache_rdata;
-    raw_sdp_block_ram#(lwidth+lswidth, 4*ways, 8, "", 1) cache_ram(
-        clk, cache_we, cache_waddr, cache_wdata, cache_raddr, cache_rdata
+    logic[xm_dlen*ways-1:0]     cache_rdata;
+    raw_sdp_block_ram#(lwidth+lswidth-xwbits, 4*xw*ways, 8, "", 1) cache_ram(
+        clk, cache_we, cache_waddr[lwidth+lswidth-1:xwbits], cache_wdata, cache_raddr[lwidth+lswidth-1:xwbits], cache_rdata
     );
     
+    // Word within an extmem word of the access.
+    wire [5:0]          ab_shift = xw > 1 ? 32 * ab_addr[2] : 0;
+    
     // Read data.
-    logic[31:0] rcache_rdata[ways];
+    logic[xm_dlen-1:0]  rcache_rdata[ways];
     generate
         for (x = 0; x < ways; x = x + 1) begin
-            assign rcache_rdata[x] = cache_rdata[32*x+31:32*x];
+            assign rcache_rdata[x] = cache_rdata[xm_dlen*x+xm_dlen-1:xm_dlen*x];
         end
     endgenerate
     
     // Write data.
-    logic[3:0]          wcache_we;
+    logic[4*xw-1:0]     wcache_we;
     logic[wwidth-1:0]   wcache_way;
-    logic[31:0]         wcache_wdata;
+    logic[xm_dlen-1:0]  wcache_wdata;
     generate
         for (x = 0; x < ways; x = x + 1) begin
-            assign cache_wdata[32*x+31:32*x] = wcache_wdata;
-            assign cache_we[x*4+3:x*4]       = (wcache_way == x) ? wcache_we : 4'b0000;
+            assign cache_wdata[xm_dlen*x+xm_dlen-1:xm_dlen*x] = wcache_wdata;
+            assign cache_we[x*4*xw+4*xw-1:x*4*xw]             = (wcache_way == x) ? wcache_we : 0;
         end
     endgenerate
     
@@ -224,16 +300,24 @@ module boa_cache#(
     // Cache way being synced with extmem.
     logic[wwidth-1:0]           xm_way;
     // Previous extmem write data.
-    logic[31:0]                 xm_pwdata;
+    logic[xm_dlen-1:0]          xm_pwdata;
+    // Address of the access that started the current line fill.
+    logic[alen-1:2]             xm_crit;
+    // Word in the line at which the current line fill started and ends.
+    wire [agrain-1:2]           fill_start = cwf ? xm_crit[agrain-1:2] & ~(xw-1) : 0;
     
     // Next address in sequential extmem access.
     logic[alen-1:2]             xm_next_addr;
     assign xm_next_addr[alen-1:agrain]              = xm_bus.addr[alen-1:agrain];
-    assign xm_next_addr[agrain-1:2]                 = xm_addr[agrain-1:2] + 1;
+    assign xm_next_addr[agrain-1:2]                 = xm_addr[agrain-1:2] + xw;
     // Next address in sequential cachemem access.
     logic[lwidth+lswidth-1:0]   cm_next_addr;
     assign cm_next_addr[lwidth+lswidth-1:lswidth]   = cache_raddr[lwidth+lswidth-1:lswidth];
-    assign cm_next_addr[lswidth-1:0]                = cm_addr[lswidth-1:0] + 1;
+    assign cm_next_addr[lswidth-1:0]                = cm_addr[lswidth-1:0] + xw;
+    // Next cache memory address for a line fill; the access that missed may have completed already.
+    logic[lwidth+lswidth-1:0]   cm_fill_next;
+    assign cm_fill_next[lwidth+lswidth-1:lswidth]   = cm_addr[lwidth+lswidth-1:lswidth];
+    assign cm_fill_next[lswidth-1:0]                = cm_addr[lswidth-1:0] + xw;
     // Initial extmem address for extmem to cache copy.
     logic[alen-1:2]             xm_init_raddr;
     assign xm_init_raddr[alen-1:agrain]             = bus.addr[alen-1:agrain];
@@ -250,50 +334,198 @@ module boa_cache#(
     // Initial cache address for extmem to cache copy.
     logic[lwidth+lswidth-1:0]   cm_init_waddr;
     assign cm_init_waddr[lwidth+lswidth-1:lswidth]  = ab_addr[alen-1:agrain];
-    assign cm_init_waddr[lswidth-1:0]               = 0;
+    assign cm_init_waddr[lswidth-1:0]               = cwf ? ab_addr[agrain-1:2] & ~(xw-1) : 0;
+    // Initial extmem address for a line fill.
+    logic[alen-1:2]             xm_fill_addr;
+    assign xm_fill_addr[alen-1:agrain]              = ab_addr[alen-1:agrain];
+    assign xm_fill_addr[agrain-1:2]                 = cwf ? ab_addr[agrain-1:2] & ~(xw-1) : 0;
+    // Second extmem address for a line fill.
+    logic[alen-1:2]             xm_fill_next;
+    assign xm_fill_next[alen-1:agrain]              = ab_addr[alen-1:agrain];
+    assign xm_fill_next[agrain-1:2]                 = xm_fill_addr[agrain-1:2] + xw;
+    // Word of the line presented to extmem this cycle during a line transfer.
+    wire [lswidth-1:0]          xm_bword            = xm_bus.ready ? xm_addr[agrain-1:2] : xm_paddr[agrain-1:2];
+    // Word of the line after the one presented to extmem.
+    wire [lswidth-1:0]          xm_bword_next       = xm_bword + xw;
+    // The first word of a line fill arrives while the access that missed is still waiting for it.
+    wire                        xm_early            = cwf && xm_to_cache && xm_bus.ready && cm_addr[lswidth-1:0] == fill_start
+                                                    && ab_re && ab_we == 0 && ab_addr == xm_crit && !ab_stall;
+    
+    // Extmem words of the line being filled that have been written to cache memory.
+    logic[line_size/xw-1:0]     fill_have;
+    // The access targets the line being filled.
+    wire                        fill_line           = ab_addr[alen-1:agrain] == xm_crit[alen-1:agrain];
+    // The word the access targets arrives from extmem this cycle.
+    wire                        fill_now            = xm_bus.ready && cm_addr[lswidth-1:xwbits] == ab_addr[agrain-1:xgrain];
+    // The last word of a line fill arrives this cycle.
+    wire                        fill_last           = xm_to_cache && xm_bus.ready && xm_addr[agrain-1:2] == fill_start;
+    // A read is served while a line fill is in progress.
+    wire                        hum_ready           = mshrs != 0 && xm_to_cache && !vb_copy && ab_re && ab_we == 0 && !ab_stall && !fl_r && !fl_w
+                                                    && (fill_line ? fill_have[ab_addr[agrain-1:xgrain]] || fill_now : tag_valid);
+    // A clean miss that arrived during a line fill is started as that fill completes.
+    wire                        fill_queue          = mshrs > 1 && fill_last && (ab_re || ab_we != 0) && !ab_stall && !(fl_r || fl_w)
+                                                    && !fill_line && !tag_valid && !rtag_dirty[rtag_wnext] && !vb_valid;
+    
+    // Victim buffer holds a line that has not been written to extmem yet.
+    logic                       vb_valid;
+    // Copying a line from cache memory to the victim buffer.
+    logic                       vb_copy;
+    // Writing the victim buffer to extmem.
+    logic                       vb_drain;
+    // Waiting for the last victim buffer write to complete.
+    logic                       vb_pend;
+    // Address of the line in the victim buffer.
+    logic[alen-1:agrain]        vb_addr;
+    // Cache way the victim buffer is copied from.
+    logic[wwidth-1:0]           vb_way;
+    // Word the copy started at.
+    logic[lswidth-1:0]          vb_first;
+    // Word being copied into the victim buffer.
+    logic[lswidth-1:0]          vb_cidx;
+    // Next word to copy into the victim buffer.
+    wire [lswidth-1:0]          vb_cnext            = vb_cidx + xw;
+    // Next word to write to extmem.
+    logic[lswidth-1:0]          vb_didx;
+    // Word written to extmem this cycle.
+    wire [lswidth-1:0]          vb_xidx             = xm_bus.ready ? vb_didx : vb_didx - xw;
+    // Victim buffer data, per extmem word.
+    logic[xm_dlen-1:0]          vb_data[line_size/xw];
+    // A read is served from the victim buffer.
+    wire                        vb_hit              = victim_buf && vb_valid && !vb_copy && ab_re && ab_we == 0 && !ab_stall
+                                                    && ab_addr[alen-1:agrain] == vb_addr;
+    
+    // A line fill is started for a non-resident access this cycle.
+    wire                        xm_start            = (ab_re || ab_we != 0) && !tag_valid && !ab_stall && !vb_valid
+                                                    && !xm_to_cache && !cache_to_xm && !(pcache_to_xm && !xm_bus.ready) && !fl_r && !fl_w;
+    // The line fill evicts a dirty line to the victim buffer.
+    wire                        vb_start            = victim_buf && xm_start && rtag_dirty[rtag_wnext];
+    // The victim line is written to extmem before the line fill starts.
+    wire                        xm_evict            = !victim_buf && rtag_dirty[rtag_wnext];
+    // A prefetch is dropped because it would evict a dirty line.
+    wire                        pf_drop             = ab_pf && xm_evict;
+    
+    // Line being invalidated.
+    wire [lwidth-1:0]           fl_cur_line         = fl_pi ? fl_addr[agrain+lwidth-1:agrain] : fl_line;
+    // Way being invalidated.
+    wire [wwidth-1:0]           fl_cur_way          = fl_pi ? tag_way : fl_way;
+    // The way being invalidated is dirty.
+    wire                        fl_cur_dirty        = fl_pi ? tag_dirty : rtag_dirty[fl_way];
+    // Extmem address of the line being invalidated.
+    wire [alen-1:2]             fl_waddr            = {rtag_addr[fl_cur_way], fl_cur_line, {lswidth{1'b0}}};
+    // An invalidation operation is performed this cycle.
+    wire                        fl_step             = (fl_r || fl_w) && fl_rdy && !vb_valid
+                                                    && !xm_to_cache && !cache_to_xm && !(pcache_to_xm && !xm_bus.ready);
+    // Lines that may be dirty or stale, including those written to this cycle.
+    logic[lines-1:0]            fl_dirty_now;
+    always @(*) begin
+        fl_dirty_now = fl_dirty;
+        if (tag_we && etag_dirty) begin
+            fl_dirty_now[tag_waddr] = 1;
+        end
+        if (snoop && snoop_we) begin
+            fl_dirty_now[snoop_addr[tgrain-1:agrain]] = 1;
+        end
+    end
+    // First line an imprecise invalidation visits.
+    logic[lwidth-1:0]           fl_first;
+    // Line visited after the current one.
+    logic[lwidth-1:0]           fl_next;
+    // There is a line to visit after the current one.
+    logic                       fl_more;
+    always @(*) begin
+        integer i;
+        fl_first = 0;
+        fl_next  = 'bx;
+        fl_more  = 0;
+        for (i = lines-1; i >= 0; i = i - 1) begin
+            // Flushing only writes, or only snooped lines, skips the lines that are known to be clean.
+            if ((flush_r && !snoop) || fl_dirty_now[i]) begin
+                fl_first = i;
+            end
+            if (i > fl_line && (fl_all || fl_dirty[i])) begin
+                fl_next = i;
+                fl_more = 1;
+            end
+        end
+    end
+    // This is the last invalidation operation.
+    wire                        fl_end              = fl_pi || (fl_way == ways-1 && !fl_more);
+    
+    // The prefetch is moved into the access buffer this cycle.
+    assign                      pf_inject           = pf_valid && !bus.re && bus.we == 0 && !stall && !vb_valid
+                                                    && !xm_to_cache && !cache_to_xm && !pcache_to_xm && !fl_r && !fl_w;
     
     // Cache state machine.
     always @(posedge clk) begin
         pcache_to_xm <= cache_to_xm || (pcache_to_xm && !xm_bus.ready);
-        if (rst && (!fl_r || fl_w || fl_pi)) begin
+        if (rst && (!fl_r || fl_w || fl_pi || !fl_all)) begin
             // Invalidate the entire cache after a reset.
-            fl_r    <= 1;
-            fl_w    <= 0;
-            fl_pi   <= 0;
-            fl_line <= 'bx;
-            fl_way  <= 'bx;
-            fl_addr <= 'bx;
+            fl_r     <= 1;
+            fl_w     <= 0;
+            fl_pi    <= 0;
+            fl_all   <= 1;
+            fl_rdy   <= 0;
+            fl_line  <= 0;
+            fl_way   <= 0;
+            fl_addr  <= 'bx;
+            fl_dirty <= 0;
         end else if (fl_r || fl_w) begin
             // Performing an invalidation.
+            fl_rdy  <= 1;
         end else if (pi_en && (flush_r || flush_w)) begin
             // Start a precise invalidation.
             fl_r    <= flush_r;
             fl_w    <= flush_w;
             fl_pi   <= 1;
+            fl_all  <= 0;
+            fl_rdy  <= 0;
             fl_line <= 'bx;
             fl_way  <= 'bx;
             fl_addr <= pi_addr;
-        end else if (flush_r || flush_w && writeable) begin
+        end else if (flush_r && (!snoop || fl_dirty_now != 0) || flush_w && writeable && (fl_dirty_now != 0 || vb_valid)) begin
             // Start an imprecise invalidation.
             fl_r    <= flush_r;
             fl_w    <= flush_w;
             fl_pi   <= 0;
-            fl_line <= 0;
+            fl_all  <= flush_r && !snoop;
+            fl_rdy  <= 0;
+            fl_line <= fl_first;
             fl_way  <= 0;
             fl_addr <= 'bx;
         end
+        if (rst) begin
+            pf_valid <= 0;
+        end else if (prefetch) begin
+            // Prefetch requested; replaces any prefetch that is still waiting.
+            pf_valid <= 1;
+            pf_addr  <= pi_addr;
+        end else if (pf_inject) begin
+            pf_valid <= 0;
+        end
         if (!xm_bus.ready && xm_to_cache) begin
             // Waiting on extmem read.
         end else if (!xm_bus.ready && (cache_to_xm || (pcache_to_xm && !xm_bus.ready))) begin
             // Waiting on extmem write.
+        end else if (fill_queue) begin
+            // Line fill completed; start the fill for the queued miss.
+            xm_to_cache <= 1;
+            cache_to_xm <= 0;
+            xm_way      <= rtag_wnext;
+            xm_crit     <= ab_addr;
+            xm_addr     <= xm_fill_next;
+            cm_addr     <= cm_init_waddr;
+            xm_paddr    <= xm_bus.addr;
+            cm_paddr    <= cache_raddr;
+            fill_have   <= 0;
         end else if (xm_to_cache) begin
             // Reading a cache line.
-            xm_to_cache <= xm_addr[agrain-1:2] != 0;
+            xm_to_cache <= !fill_last;
             cache_to_xm <= 0;
-            xm_addr     <= (xm_addr[agrain-1:2] != 0) ? xm_next_addr : xm_init_raddr;
-            cm_addr     <= cm_next_addr;
+            xm_addr     <= !fill_last ? xm_next_addr : xm_init_raddr;
+            cm_addr     <= !fill_last ? cm_fill_next : cm_init_raddr;
             xm_paddr    <= xm_bus.addr;
             cm_paddr    <= cache_raddr;
+            fill_have[cm_addr[lswidth-1:xwbits]] <= 1;
         end else if (writeable && cache_to_xm) begin
             // Flushing a dirty cache line.
             xm_to_cache <= 0;
@@ -303,34 +535,42 @@ module boa_cache#(
             xm_paddr    <= xm_bus.addr;
             cm_paddr    <= cache_raddr;
             xm_pwdata   <= xm_bus.wdata;
+        end else if ((fl_r || fl_w) && !fl_step) begin
+            // Cache invalidation waits for the tag read or for the victim buffer to drain.
         end else if (fl_r || fl_w) begin
             // Cache invalidation.
-            if (fl_end) begin
-                fl_r    <= 0;
-                fl_w    <= 0;
-            end
-            if (fl_way == ways-1) begin
-                fl_line <= fl_line + 1;
-            end
-            fl_way <= fl_way + 1;
-            if (fl_w && (fl_pi ? rtag_dirty[tag_way] : rtag_dirty[fl_way])) begin
+            if (fl_w && fl_cur_dirty) begin
+                // Dirty way is written back, then visited again.
                 xm_to_cache <= 0;
                 cache_to_xm <= 1;
-                xm_way      <= fl_pi ? tag_way : fl_way;
-                xm_addr     <= xm_init_waddr;
-                cm_addr     <= cm_next_addr;
+                xm_way      <= fl_cur_way;
+                xm_addr     <= fl_waddr;
+                cm_addr     <= {fl_cur_line, {lswidth{1'b0}}} + xw;
+            end else begin
+                if (fl_end) begin
+                    fl_r    <= 0;
+                    fl_w    <= 0;
+                end
+                if (!fl_pi && fl_way == ways-1) begin
+                    // All ways in this line are now clean or invalid.
+                    fl_dirty[fl_line] <= 0;
+                    fl_line <= fl_next;
+                end
+                fl_way <= fl_way + 1;
             end
             xm_paddr    <= xm_bus.addr;
             cm_paddr    <= cache_raddr;
-        end else if ((ab_re || ab_we != 0) && !tag_valid && !ab_stall) begin
+        end else if ((ab_re || ab_we != 0) && !tag_valid && !ab_stall && !vb_valid && !pf_drop) begin
             // Non-resident access.
-            xm_to_cache <= !rtag_dirty[rtag_wnext];
-            cache_to_xm <= rtag_dirty[rtag_wnext];
+            xm_to_cache <= !xm_evict;
+            cache_to_xm <= xm_evict;
             xm_way      <= rtag_wnext;
-            xm_addr     <= rtag_dirty[rtag_wnext] ? xm_init_waddr : xm_next_addr;
-            cm_addr     <= rtag_dirty[rtag_wnext] ? cm_next_addr  : cm_init_waddr;
+            xm_crit     <= ab_addr;
+            xm_addr     <= xm_evict ? xm_init_waddr : xm_fill_next;
+            cm_addr     <= xm_evict ? cm_next_addr  : cm_init_waddr;
             xm_paddr    <= xm_bus.addr;
             cm_paddr    <= cache_raddr;
+            fill_have   <= 0;
         end else begin
             // Cache is idle.
             xm_to_cache <= 0;
@@ -341,6 +581,54 @@ module boa_cache#(
             xm_paddr    <= xm_bus.addr;
             cm_paddr    <= cache_raddr;
         end
+        if (tag_we && etag_dirty) begin
+            // Line written to.
+            fl_dirty[tag_waddr] <= 1;
+        end
+        if (snoop && snoop_we) begin
+            // Line written to elsewhere; may now be stale.
+            fl_dirty[snoop_addr[tgrain-1:agrain]] <= 1;
+        end
+    end
+    
+    // Victim buffer state machine.
+    always @(posedge clk) begin
+        if (rst) begin
+            vb_valid    <= 0;
+            vb_copy     <= 0;
+            vb_drain    <= 0;
+            vb_pend     <= 0;
+        end else if (vb_start) begin
+            // Dirty line evicted; copy it in the same order the line fill overwrites it.
+            vb_valid    <= 1;
+            vb_copy     <= 1;
+            vb_addr     <= {rtag_addr[rtag_wnext], ab_addr[tgrain-1:agrain]};
+            vb_way      <= rtag_wnext;
+            vb_first    <= cm_init_waddr[lswidth-1:0];
+            vb_cidx     <= cm_init_waddr[lswidth-1:0];
+        end else begin
+            if (vb_copy) begin
+                // Copying from cache memory.
+                // The line fill is at least one word behind, so the copy is done by the time the fill completes.
+                vb_data[vb_cidx[lswidth-1:xwbits]] <= rcache_rdata[vb_way];
+                vb_cidx          <= vb_cnext;
+                vb_copy          <= vb_cnext != vb_first;
+            end
+            if (vb_drain && xm_bus.ready) begin
+                // Writing to extmem.
+                vb_didx     <= vb_didx + xw;
+                vb_drain    <= vb_didx != line_size - xw;
+                vb_pend     <= vb_didx == line_size - xw;
+            end else if (vb_pend && xm_bus.ready) begin
+                // Victim buffer drained.
+                vb_valid    <= 0;
+                vb_pend     <= 0;
+            end else if (vb_valid && !vb_drain && !vb_pend && (fill_last || !xm_to_cache)) begin
+                // Line fill completed; start draining.
+                vb_drain    <= 1;
+                vb_didx     <= 0;
+            end
+        end
     end
     
     // Cache RAM write access logic.
@@ -351,99 +639,188 @@ module boa_cache#(
         xm_bus.we                   = 0;
         xm_bus.addr                 = 'bx;
         xm_bus.wdata                = 'bx;
+        xm_bus.blen                 = 0;
+        xm_bus.bwrap                = 0;
+        xm_bus.blast                = 1;
         // Cache memory is idle.
         wcache_we                   = 0;
         wcache_way                  = 'bx;
         wcache_wdata                = 'bx;
         cache_waddr                 = 'bx;
+        // No line fill started.
+        miss                        = 0;
         // Tag memory is idle.
         tag_we                      = 0;
         tag_waddr                   = 'bx;
         etag_way                    = 'bx;
-        wtag_wnext                  = 'bx;
+        wtag_repl                   = 'bx;
         etag_valid                  = 'bx;
         etag_dirty                  = 'bx;
         etag_addr                   = 'bx;
         if (xm_to_cache) begin
             // Reading a cache line.
-            xm_bus.re                   = !xm_bus.ready || (xm_addr[agrain-1:2] != 0);
+            xm_bus.re                   = !xm_bus.ready || (xm_addr[agrain-1:2] != fill_start);
             xm_bus.addr                 = xm_bus.ready ? xm_addr : xm_paddr;
+            xm_bus.blen                 = xm_blen;
+            xm_bus.bwrap                = cwf;
+            xm_bus.blast                = xm_blen == 0 || xm_bword_next == fill_start;
             // Writing to cache memory.
-            wcache_we                   = xm_bus.ready ? 4'b1111 : 4'b0000;
+            wcache_we                   = xm_bus.ready ? {4*xw{1'b1}} : 0;
             wcache_way                  = xm_way;
             wcache_wdata                = xm_bus.rdata;
             cache_waddr                 = cm_addr;
+            if (fill_queue) begin
+                // Queued miss; initiate extmem read.
+                miss                        = 1;
+                xm_bus.re                   = 1;
+                xm_bus.addr                 = xm_fill_addr;
+                xm_bus.blen                 = xm_blen;
+                xm_bus.bwrap                = cwf;
+                xm_bus.blast                = xm_blen == 0;
+                // Create new cache tag.
+                tag_we                      = 1;
+                tag_waddr                   = ab_addr[agrain+lwidth-1:agrain];
+                etag_way                    = rtag_wnext;
+                wtag_repl                   = repl_fill;
+                etag_valid                  = 1;
+                etag_dirty                  = 0;
+                etag_addr                   = ab_addr[alen-1:tgrain];
+            end else if (hum_ready && !fill_line && replacement != "rr") begin
+                // Resident read access during a line fill.
+                // Updating replacement state.
+                tag_we                      = 1;
+                tag_waddr                   = ab_addr[agrain+lwidth-1:agrain];
+                etag_way                    = tag_way;
+                wtag_repl                   = repl_hit;
+                etag_valid                  = 1;
+                etag_dirty                  = rtag_dirty[tag_way];
+                etag_addr                   = ab_addr[alen-1:tgrain];
+            end
         end else if (cache_to_xm || (!xm_bus.ready && pcache_to_xm)) begin
             // Flushing a dirty cache line.
-            xm_bus.we                   = 4'b1111;
+            xm_bus.we                   = {4*xw{1'b1}};
             xm_bus.addr                 = xm_bus.ready ? xm_addr : xm_paddr;
             xm_bus.wdata                = xm_bus.ready ? rcache_rdata[xm_way] : xm_pwdata;
+            xm_bus.blen                 = xm_blen;
+            xm_bus.blast                = xm_blen == 0 || xm_bword == line_size - xw;
+        end else if ((fl_r || fl_w) && !fl_step) begin
+            // Cache invalidation waits for the tag read or for the victim buffer to drain.
         end else if (fl_r || fl_w) begin
             // Cache invalidation.
             // Change tag flags.
             tag_we                      = fl_pi ? tag_valid : 1;
-            tag_waddr                   = fl_pi ? fl_addr[agrain+lwidth-1:agrain] : fl_line;
-            etag_way                    = fl_pi ? tag_way : fl_way;
-            wtag_wnext                  = rtag_wnext;
-            etag_valid                  = !fl_r;
+            tag_waddr                   = fl_cur_line;
+            etag_way                    = fl_cur_way;
+            wtag_repl                   = fl_r ? repl_init : rtag_repl;
+            etag_valid                  = !fl_r && rtag_valid[fl_cur_way];
             etag_dirty                  = 0;
             etag_addr                   = rtag_addr[etag_way];
         end else if (ab_we != 0 && tag_valid) begin
             // Resident write access.
             // Writing to cache memory.
-            wcache_we                   = ab_we;
+            wcache_we                   = ab_we << ab_shift / 8;
             wcache_way                  = tag_way;
-            wcache_wdata                = ab_wdata;
+            wcache_wdata                = {xw{ab_wdata}};
             cache_waddr                 = ab_addr[tgrain-1:2];
             // Marking tag as dirty.
             tag_we                      = 1;
             tag_waddr                   = ab_addr[agrain+lwidth-1:agrain];
             etag_way                    = tag_way;
-            wtag_wnext                  = rtag_wnext;
+            wtag_repl                   = repl_hit;
             etag_valid                  = 1;
             etag_dirty                  = 1;
             etag_addr                   = ab_addr[alen-1:tgrain];
-        end else if ((ab_re || ab_we != 0) && !tag_valid && rtag_dirty[rtag_wnext]) begin
+        end else if (ab_re && tag_valid && replacement != "rr") begin
+            // Resident read access.
+            // Updating replacement state.
+            tag_we                      = 1;
+            tag_waddr                   = ab_addr[agrain+lwidth-1:agrain];
+            etag_way                    = tag_way;
+            wtag_repl                   = repl_hit;
+            etag_valid                  = 1;
+            etag_dirty                  = rtag_dirty[tag_way];
+            etag_addr                   = ab_addr[alen-1:tgrain];
+        end else if ((ab_re || ab_we != 0) && !tag_valid && (vb_valid || ab_stall || pf_drop)) begin
+            // Non-resident access; waiting for the victim buffer to drain or the stall to end, or prefetch dropped.
+        end else if ((ab_re || ab_we != 0) && !tag_valid && xm_evict) begin
             // Non-resident access; dirty tag needs flushing.
             // Marking tag as clean.
             tag_we                      = 1;
             tag_waddr                   = ab_addr[agrain+lwidth-1:agrain];
             etag_way                    = rtag_wnext;
-            wtag_wnext                  = rtag_wnext;
+            wtag_repl                   = rtag_repl;
             etag_valid                  = 1;
             etag_dirty                  = 0;
             etag_addr                   = rtag_addr[etag_way];
-        end else if ((ab_re || ab_we != 0) && !tag_valid && !rtag_dirty[rtag_wnext]) begin
-            // Non-resident access; clean tag evicted.
+        end else if ((ab_re || ab_we != 0) && !tag_valid) begin
+            // Non-resident access; clean tag evicted or dirty tag moved to the victim buffer.
             // Initiate extmem read.
+            miss                        = !ab_pf;
             xm_bus.re                   = 1;
-            xm_bus.addr                 = xm_init_raddr;
+            xm_bus.addr                 = xm_fill_addr;
+            xm_bus.blen                 = xm_blen;
+            xm_bus.bwrap                = cwf;
+            xm_bus.blast                = xm_blen == 0;
             // Create new cache tag.
             tag_we                      = 1;
             tag_waddr                   = ab_addr[agrain+lwidth-1:agrain];
             etag_way                    = rtag_wnext;
-            wtag_wnext                  = rtag_wnext + 1;
+            wtag_repl                   = repl_fill;
             etag_valid                  = 1;
             etag_dirty                  = 0;
             etag_addr                   = ab_addr[alen-1:tgrain];
         end
+        if (vb_drain || (vb_pend && !xm_bus.ready)) begin
+            // Draining the victim buffer.
+            xm_bus.we                   = {4*xw{1'b1}};
+            xm_bus.addr                 = {vb_addr, vb_xidx};
+            xm_bus.wdata                = vb_data[vb_xidx[lswidth-1:xwbits]];
+            xm_bus.blen                 = xm_blen;
+            xm_bus.bwrap                = 0;
+            xm_bus.blast                = xm_blen == 0 || vb_xidx == line_size - xw;
+        end
     end
     
     // Cache RAM read access logic.
     assign flushing_r = fl_r;
     assign flushing_w = fl_w;
+    assign dirty      = writeable && (fl_dirty != 0 || vb_valid);
     always @(*) begin
         if (fl_r || fl_w) begin
             // Cache invalidation.
             bus.ready = !ab_re && ab_we == 0;
             bus.rdata = 'bx;
-            if (fl_end) begin
+            if (fl_step && fl_w && fl_cur_dirty) begin
+                // Tag read prepared for visiting this way again.
+                tag_raddr = fl_cur_line;
+            end else if (fl_step && fl_end) begin
                 // Tag read prepared for an access.
                 tag_raddr = bus.addr[agrain+lwidth-1:agrain];
+            end else if (fl_step && fl_way == ways-1) begin
+                // Tag read prepared for the next line.
+                tag_raddr = fl_next;
             end else begin
                 // Tag read prepared for another invalidation.
-                tag_raddr = (fl_way == ways-1) + fl_line;
+                tag_raddr = fl_cur_line;
+            end
+        end else if (vb_hit) begin
+            // Read served from the victim buffer.
+            bus.ready = 1;
+            bus.rdata = vb_data[ab_addr[agrain-1:xgrain]][ab_shift +: 32];
+            // Tag read prepared for next access.
+            tag_raddr = bus.addr[agrain+lwidth-1:agrain];
+        end else if (xm_early || hum_ready) begin
+            // Read served while a line fill is in progress.
+            bus.ready = 1;
+            if (!fill_line) begin
+                bus.rdata = rcache_rdata[tag_way][ab_shift +: 32];
+            end else if (fill_have[ab_addr[agrain-1:xgrain]]) begin
+                bus.rdata = rcache_rdata[xm_way][ab_shift +: 32];
+            end else begin
+                bus.rdata = xm_bus.rdata[ab_shift +: 32];
             end
+            // Tag read prepared for an access.
+            tag_raddr = bus.addr[agrain+lwidth-1:agrain];
         end else if (xm_to_cache || cache_to_xm) begin
             // Accessing extmem, cache is busy.
             bus.ready = !ab_re && ab_we == 0;
@@ -453,7 +830,7 @@ module boa_cache#(
         end else if ((ab_re || ab_we != 0) && tag_valid) begin
             // Resident access.
             bus.ready = !ab_stall;
-            bus.rdata = rcache_rdata[tag_way];
+            bus.rdata = rcache_rdata[tag_way][ab_shift +: 32];
             // Tag read prepared for next access.
             tag_raddr = bus.addr[agrain+lwidth-1:agrain];
         end else if ((ab_re || ab_we != 0) && !tag_valid) begin
@@ -469,21 +846,117 @@ module boa_cache#(
             // Tag read prepared for an access.
             tag_raddr = bus.addr[agrain+lwidth-1:agrain];
         end
-        if (pcache_to_xm && !xm_bus.ready) begin
+        if (vb_start) begin
+            // Copying the first word to the victim buffer.
+            cache_raddr = cm_init_waddr;
+        end else if (vb_copy && vb_cnext != vb_first) begin
+            // Copying to the victim buffer.
+            cache_raddr = {vb_addr[tgrain-1:agrain], vb_cnext};
+        end else if (pcache_to_xm && !xm_bus.ready) begin
             // Waiting for extmem.
             cache_raddr = cm_paddr;
         end else if (cache_to_xm && cm_addr[lswidth-1:0] != 0) begin
             // Copying from cache to extmem.
             cache_raddr = xm_bus.ready ? cm_addr : cm_paddr;
-        end else if (fl_w && rtag_dirty[fl_pi ? tag_way : fl_way]) begin
+        end else if (fl_step && fl_w && fl_cur_dirty) begin
             // Cache invalidation; dirty tag needs flushing.
-            cache_raddr = fl_pi ? fl_addr : fl_line;
-        end else if ((ab_re || ab_we != 0) && !tag_valid && rtag_dirty[rtag_wnext]) begin
+            cache_raddr = {fl_cur_line, {lswidth{1'b0}}};
+        end else if ((ab_re || ab_we != 0) && !tag_valid && xm_evict) begin
             // Non-resident access; dirty tag needs flushing.
             cache_raddr = cm_addr;
         end else begin
             // Reading from cache.
             cache_raddr = bus.addr[tgrain-1:2];
         end
+        if (pf_inject) begin
+            // Tag read prepared for a prefetch.
+            tag_raddr = pf_addr[agrain+lwidth-1:agrain];
+        end
     end
 endmodule
+
+
+
+// Cache replacement policy helper.
+module boa_cache_repl#(
+    // Number of cache ways.
+    parameter  ways         = 2,
+    // Replacement policy: "rr", "plru" or "lru".
+    parameter  replacement  = "rr",
+    // Number of bits required to address a way.
+    localparam wwidth       = $clog2(ways),
+    // Number of bits required to store the replacement state of a line.
+    localparam rwidth       = replacement == "lru" ? ways*wwidth : replacement == "plru" ? ways-1 : wwidth
+)(
+    // Current replacement state.
+    input  logic[rwidth-1:0]    state,
+    // Way that was hit.
+    input  logic[wwidth-1:0]    hit_way,
+    
+    // Way to evict next.
+    output logic[wwidth-1:0]    victim,
+    // Replacement state after an invalidation.
+    output logic[rwidth-1:0]    init_state,
+    // Replacement state after filling the victim way.
+    output logic[rwidth-1:0]    fill_state,
+    // Replacement state after a hit on `hit_way`.
+    output logic[rwidth-1:0]    hit_state
+);
+    genvar x;
+    
+    generate
+        if (replacement == "plru") begin: plru
+            // Tree of ways-1 bits stored as a heap; node n has children 2n and 2n+1, root is 1.
+            // Each bit points towards the least recently used half of its subtree.
+            always @(*) begin
+                integer i, node;
+                // Follow the bits to the pseudo-least recently used way.
+                node = 1;
+                for (i = 0; i < wwidth; i = i + 1) begin
+                    node = node * 2 + state[node-1];
+                end
+                victim = node - ways;
+                // Point every node on the path away from the accessed way.
+                init_state = 0;
+                fill_state = state;
+                hit_state  = state;
+                node = 1;
+                for (i = wwidth-1; i >= 0; i = i - 1) begin
+                    fill_state[node-1] = !victim[i];
+                    node = node * 2 + victim[i];
+                end
+                node = 1;
+                for (i = wwidth-1; i >= 0; i = i - 1) begin
+                    hit_state[node-1] = !hit_way[i];
+                    node = node * 2 + hit_way[i];
+                end
+            end
+            
+        end else if (replacement == "lru") begin: lru
+            // One age per way; 0 is the most recently used and ways-1 the least recently used.
+            logic[wwidth-1:0] age[ways];
+            for (x = 0; x < ways; x = x + 1) begin
+                assign age[x] = state[wwidth*x+wwidth-1:wwidth*x];
+            end
+            always @(*) begin
+                integer i;
+                victim = 0;
+                for (i = 0; i < ways; i = i + 1) begin
+                    victim |= age[i] == ways - 1 ? i : 0;
+                end
+                for (i = 0; i < ways; i = i + 1) begin
+                    init_state[wwidth*i+:wwidth] = i;
+                    fill_state[wwidth*i+:wwidth] = i == victim  ? 0 : age[i] < age[victim]  ? age[i] + 1 : age[i];
+                    hit_state [wwidth*i+:wwidth] = i == hit_way ? 0 : age[i] < age[hit_way] ? age[i] + 1 : age[i];
+                end
+            end
+            
+        end else begin: rr
+            // Index of the oldest way.
+            assign victim     = state;
+            assign init_state = state;
+            assign fill_state = state + 1;
+            assign hit_state  = state;
+        end
+    endgenerate
+endmodule
@@ -0,0 +1,227 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// QSPI (QPI) or octal PSRAM controller, using single data rate transfers at half the CPU clock.
+// Every transaction sends a command and a 24-bit byte address on all data lines, followed by wait clocks for reads.
+// The chip select stays low between consecutive beats of a burst, so those only cost the data transfer.
+// In QSPI mode, QPI mode is entered after reset by sending command 0x35 in SPI mode.
+module boa_extmem_psram#(
+    // Address width of the PSRAM in bytes, at most 24.
+    parameter  psram_alen   = 23,
+    // Number of data lines, 4 (QSPI) or 8 (octal).
+    parameter  io_width     = 4,
+    // Number of wait clocks between the address and the read data, at least 1.
+    parameter  rd_wait      = 6,
+    // Read command.
+    parameter  rd_cmd       = 8'heb,
+    // Write command.
+    parameter  wr_cmd       = 8'h38,
+    // Number of clocks per byte.
+    localparam ppb          = 8 / io_width,
+    // Number of address bits within a PSRAM page, which transactions may not cross.
+    localparam page_bits    = psram_alen < 10 ? psram_alen : 10
+)(
+    // CPU clock.
+    input  logic                clk,
+    // Synchronous reset.
+    input  logic                rst,
+    
+    // Internal memory bus.
+    boa_mem_bus.MEM             bus,
+    
+    // PSRAM chip select, active low.
+    output logic                xm_ce_n,
+    // PSRAM clock.
+    output logic                xm_sclk,
+    // PSRAM data output enable.
+    output logic                xm_oe,
+    // PSRAM data output.
+    output logic[io_width-1:0]  xm_sio_out,
+    // PSRAM data input.
+    input  logic[io_width-1:0]  xm_sio_in
+);
+    // Sending the command that enters QPI mode.
+    localparam st_init  = 0;
+    // Chip select is high, no transaction.
+    localparam st_idle  = 1;
+    // Sending command and address.
+    localparam st_cmd   = 2;
+    // Waiting for read data.
+    localparam st_wait  = 3;
+    // Transferring data.
+    localparam st_data  = 4;
+    // A word was completed; the transaction is kept open if the next beat of a burst follows.
+    localparam st_hold  = 5;
+    // Chip select is high after a transaction.
+    localparam st_end   = 6;
+    
+    // Controller state.
+    logic[2:0]              state;
+    // Clocks left in the current state or byte.
+    logic[5:0]              cnt;
+    // Output shift register.
+    logic[31:0]             sh;
+    // Byte of the word being transferred.
+    logic[1:0]              bidx;
+    
+    // Access accepted but not completed.
+    logic                   ab_valid;
+    // Read enable buffer.
+    logic                   ab_re;
+    // Write enables of bytes that have not been written yet.
+    logic[3:0]              ab_we;
+    // Address buffer.
+    logic[psram_alen-1:2]   ab_addr;
+    // Write data buffer.
+    logic[31:0]             ab_wdata;
+    // Access is a beat of a burst that is followed by another.
+    logic                   ab_burst;
+    // Read data buffer.
+    logic[31:0]             rdata;
+    
+    // First byte a transaction for the buffered access starts at.
+    logic[1:0]              start_byte;
+    always @(*) begin
+        integer i;
+        start_byte = 0;
+        for (i = 3; i >= 0; i = i - 1) begin
+            if (ab_re || ab_we[i]) begin
+                start_byte = i;
+            end
+        end
+    end
+    // The access presented continues the open transaction.
+    wire                    cont        = bus.ready && ab_burst && bus.addr[psram_alen-1:2] == ab_addr + 1
+                                        && bus.addr[page_bits-1:2] != 0 && (ab_re ? bus.re : bus.we[0] && bidx == 3);
+    // Write enables left after the current byte.
+    wire [3:0]              we_left     = ab_we & ~(4'b1 << bidx);
+    // Falling edge of the PSRAM clock.
+    wire                    fall        = xm_sclk;
+    
+    // Internal bus logic.
+    assign bus.rdata = rdata;
+    always @(posedge clk) begin
+        if (rst) begin
+            // Reset; enter QPI mode if needed.
+            state       <= io_width == 4 ? st_init : st_idle;
+            cnt         <= 7;
+            sh          <= {8'h35, 24'h0};
+            bidx        <= 'bx;
+            xm_ce_n     <= io_width != 4;
+            xm_sclk     <= 0;
+            xm_oe       <= 1;
+            ab_valid    <= 0;
+            ab_re       <= 0;
+            ab_we       <= 0;
+            ab_addr     <= 'bx;
+            ab_wdata    <= 'bx;
+            ab_burst    <= 0;
+            bus.ready   <= 1;
+        end else begin
+            if (bus.ready && (bus.re || bus.we != 0)) begin
+                // Accept a new access.
+                ab_valid    <= 1;
+                ab_re       <= bus.re;
+                ab_we       <= bus.we;
+                ab_addr     <= bus.addr;
+                ab_wdata    <= bus.wdata;
+                ab_burst    <= bus.blen != 0 && !bus.blast;
+                bus.ready   <= 0;
+            end
+            
+            if ((state == st_idle || state == st_end) && ab_valid) begin
+                // Start a transaction.
+                state       <= st_cmd;
+                cnt         <= 32 / io_width - 1;
+                sh          <= {ab_re ? rd_cmd[7:0] : wr_cmd[7:0], 24'({ab_addr, start_byte})};
+                bidx        <= start_byte;
+                xm_ce_n     <= 0;
+                xm_oe       <= 1;
+            end else if (state == st_idle || state == st_end) begin
+                // Idle.
+                state       <= st_idle;
+                xm_ce_n     <= 1;
+                xm_oe       <= 1;
+            end else if (state == st_hold && cont) begin
+                // Next beat of the burst continues the transaction.
+                state       <= st_data;
+                cnt         <= ppb - 1;
+                sh          <= {bus.wdata[7:0], 24'h0};
+                bidx        <= 0;
+            end else if (state == st_hold) begin
+                // End the transaction.
+                state       <= st_end;
+                xm_ce_n     <= 1;
+                xm_oe       <= 1;
+            end else if (!fall) begin
+                // Rising edge of the PSRAM clock.
+                xm_sclk     <= 1;
+            end else if (state == st_init) begin
+                // Sending the command that enters QPI mode.
+                xm_sclk     <= 0;
+                sh          <= sh << 1;
+                cnt         <= cnt - 1;
+                if (cnt == 0) begin
+                    state       <= st_end;
+                    xm_ce_n     <= 1;
+                end
+            end else if (state == st_cmd) begin
+                // Sending command and address.
+                xm_sclk     <= 0;
+                sh          <= sh << io_width;
+                cnt         <= cnt - 1;
+                if (cnt == 0 && ab_re) begin
+                    state       <= st_wait;
+                    cnt         <= rd_wait - 1;
+                    xm_oe       <= 0;
+                end else if (cnt == 0) begin
+                    state       <= st_data;
+                    cnt         <= ppb - 1;
+                    sh          <= {ab_wdata[bidx*8 +: 8], 24'h0};
+                end
+            end else if (state == st_wait) begin
+                // Waiting for read data.
+                xm_sclk     <= 0;
+                cnt         <= cnt - 1;
+                if (cnt == 0) begin
+                    state       <= st_data;
+                    cnt         <= ppb - 1;
+                end
+            end else begin
+                // Transferring data.
+                xm_sclk     <= 0;
+                sh          <= sh << io_width;
+                cnt         <= cnt - 1;
+                if (ab_re) begin
+                    rdata[bidx*8 +: 8] <= {rdata[bidx*8 +: 8], xm_sio_in};
+                end
+                if (cnt == 0 && bidx != 3 && (ab_re || we_left[bidx+1])) begin
+                    // Next byte in the same transaction.
+                    cnt         <= ppb - 1;
+                    sh          <= {ab_wdata[(bidx+1)*8 +: 8], 24'h0};
+                    bidx        <= bidx + 1;
+                    ab_we       <= we_left;
+                end else if (cnt == 0 && !ab_re && we_left != 0) begin
+                    // The remaining bytes to write are not contiguous; start another transaction.
+                    state       <= st_end;
+                    xm_ce_n     <= 1;
+                    xm_oe       <= 1;
+                    ab_we       <= we_left;
+                end else if (cnt == 0) begin
+                    // Access completed.
+                    state       <= st_hold;
+                    ab_valid    <= 0;
+                    ab_we       <= we_left;
+                    bus.ready   <= 1;
+                end
+            end
+        end
+    end
+    
+    // External bus logic.
+    assign xm_sio_out = state == st_init ? {{io_width-1{1'b1}}, sh[31]} : sh[31 -: io_width];
+endmodule
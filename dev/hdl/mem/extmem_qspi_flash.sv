@@ -0,0 +1,226 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Read-only QSPI flash controller for execute-in-place, using fast read quad I/O at half the CPU clock.
+// The mode bits sent after the address keep the flash in continuous read mode, so only the first transaction sends a command.
+// After the requested word, the transaction keeps streaming the following words into a small prefetch buffer,
+// so sequential reads are served from the buffer; the clock is paused while the buffer is full.
+// A read that does not follow the stream ends the transaction and starts a new one; writes are ignored.
+// After reset, continuous read mode is exited by clocking 0xff on all data lines.
+module boa_extmem_qspi_flash#(
+    // Address width of the flash in bytes, at most 24.
+    parameter  flash_alen   = 24,
+    // Number of dummy clocks between the mode bits and the read data, at least 1.
+    parameter  dummy        = 4,
+    // Number of words in the prefetch buffer, a power of two of at least 2.
+    parameter  pf_depth     = 4,
+    // Read command.
+    parameter  rd_cmd       = 8'heb,
+    // Mode bits sent after the address; 0xa0 keeps the flash in continuous read mode.
+    parameter  mode_bits    = 8'ha0,
+    // Number of bits in a prefetch buffer index.
+    localparam pf_bits      = $clog2(pf_depth)
+)(
+    // CPU clock.
+    input  logic                clk,
+    // Synchronous reset.
+    input  logic                rst,
+    
+    // Internal memory bus.
+    boa_mem_bus.MEM             bus,
+    
+    // Flash chip select, active low.
+    output logic                xm_ce_n,
+    // Flash clock.
+    output logic                xm_sclk,
+    // Flash data output enable.
+    output logic                xm_oe,
+    // Flash data output.
+    output logic[3:0]           xm_sio_out,
+    // Flash data input.
+    input  logic[3:0]           xm_sio_in
+);
+    // Exiting continuous read mode.
+    localparam st_init  = 0;
+    // Chip select is high, no transaction.
+    localparam st_idle  = 1;
+    // Sending the read command in SPI mode.
+    localparam st_cmd   = 2;
+    // Sending the address and mode bits.
+    localparam st_addr  = 3;
+    // Waiting for read data.
+    localparam st_wait  = 4;
+    // Receiving read data.
+    localparam st_data  = 5;
+    // Chip select is high after a transaction.
+    localparam st_end   = 6;
+    
+    // Controller state.
+    logic[2:0]              state;
+    // Clocks left in the current state or word.
+    logic[3:0]              cnt;
+    // Output shift register.
+    logic[31:0]             sh;
+    // The flash is in continuous read mode.
+    logic                   xip;
+    // Word being received.
+    logic[31:0]             rword;
+    
+    // Read accepted but not completed.
+    logic                   ab_valid;
+    // Address buffer.
+    logic[flash_alen-1:2]   ab_addr;
+    // Read data buffer.
+    logic[31:0]             rdata;
+    
+    // Prefetch buffer storage.
+    logic[31:0]             pbuf[pf_depth];
+    // Index of the oldest word in the prefetch buffer.
+    logic[pf_bits-1:0]      hd;
+    // Number of words in the prefetch buffer.
+    logic[pf_bits:0]        count;
+    // Address of the oldest word in the prefetch buffer, or of the next word from the flash if it is empty.
+    logic[flash_alen-1:2]   buf_addr;
+    
+    // Falling edge of the flash clock.
+    wire                    fall        = xm_sclk;
+    // Byte of the word being received.
+    wire [1:0]              bidx        = ~cnt[2:1];
+    // Word being received including the current nibble.
+    logic[31:0]             rword_next;
+    always @(*) begin
+        rword_next = rword;
+        rword_next[bidx*8 +: 8] = {rword[bidx*8 +: 4], xm_sio_in};
+    end
+    
+    // The read presented is in the prefetch buffer.
+    wire                    present_hit = count != 0 && bus.addr[flash_alen-1:2] == buf_addr;
+    // The buffered read is in the prefetch buffer.
+    wire                    pending_hit = count != 0 && ab_addr == buf_addr;
+    // A word is taken from the prefetch buffer.
+    wire                    pop         = bus.ready ? bus.re && present_hit : ab_valid && pending_hit;
+    // A word is added to the prefetch buffer.
+    wire                    push        = state == st_data && fall && cnt == 0;
+    // The buffered read does not follow the stream; the transaction is ended.
+    wire                    abort       = ab_valid && ab_addr != buf_addr && !fall;
+    
+    // Internal bus logic.
+    assign bus.rdata = rdata;
+    always @(posedge clk) begin
+        if (rst) begin
+            // Reset; exit continuous read mode.
+            state       <= st_init;
+            cnt         <= 7;
+            sh          <= 'bx;
+            xip         <= 0;
+            rword       <= 'bx;
+            xm_ce_n     <= 0;
+            xm_sclk     <= 0;
+            xm_oe       <= 1;
+            ab_valid    <= 0;
+            ab_addr     <= 'bx;
+            rdata       <= 'bx;
+            hd          <= 0;
+            count       <= 0;
+            buf_addr    <= 'bx;
+            bus.ready   <= 1;
+        end else begin
+            if (pop) begin
+                // Take a word from the prefetch buffer.
+                rdata       <= pbuf[hd];
+                hd          <= hd + 1;
+                buf_addr    <= buf_addr + 1;
+            end
+            if (push) begin
+                // Add a word to the prefetch buffer.
+                pbuf[pf_bits'(hd + count)] <= rword_next;
+            end
+            count <= count + push - pop;
+            
+            if (bus.ready && bus.re && !present_hit) begin
+                // Accept a read that is not in the prefetch buffer.
+                ab_valid    <= 1;
+                ab_addr     <= bus.addr;
+                bus.ready   <= 0;
+            end else if (!bus.ready && pop) begin
+                // Buffered read completed.
+                ab_valid    <= 0;
+                bus.ready   <= 1;
+            end
+            
+            if ((state == st_idle || state == st_end) && ab_valid) begin
+                // Start a transaction.
+                state       <= xip ? st_addr : st_cmd;
+                cnt         <= 7;
+                sh          <= xip ? {24'({ab_addr, 2'b00}), mode_bits[7:0]} : {rd_cmd[7:0], 24'h0};
+                xm_ce_n     <= 0;
+                xm_oe       <= 1;
+                buf_addr    <= ab_addr;
+                count       <= 0;
+            end else if (state == st_idle || state == st_end) begin
+                // Idle.
+                state       <= st_idle;
+                xm_ce_n     <= 1;
+                xm_oe       <= 1;
+            end else if (state != st_init && abort) begin
+                // End the transaction and discard the prefetched words.
+                state       <= st_end;
+                xm_ce_n     <= 1;
+                xm_oe       <= 1;
+                count       <= 0;
+            end else if (!fall) begin
+                // Rising edge of the flash clock, unless the buffer is full before the next word.
+                xm_sclk     <= state != st_data || cnt != 7 || count != pf_depth;
+            end else if (state == st_init) begin
+                // Exiting continuous read mode.
+                xm_sclk     <= 0;
+                cnt         <= cnt - 1;
+                if (cnt == 0) begin
+                    state       <= st_end;
+                    xm_ce_n     <= 1;
+                end
+            end else if (state == st_cmd) begin
+                // Sending the read command.
+                xm_sclk     <= 0;
+                sh          <= sh << 1;
+                cnt         <= cnt - 1;
+                if (cnt == 0) begin
+                    state       <= st_addr;
+                    cnt         <= 7;
+                    sh          <= {24'({buf_addr, 2'b00}), mode_bits[7:0]};
+                end
+            end else if (state == st_addr) begin
+                // Sending the address and mode bits.
+                xm_sclk     <= 0;
+                sh          <= sh << 4;
+                cnt         <= cnt - 1;
+                if (cnt == 0) begin
+                    state       <= st_wait;
+                    cnt         <= dummy - 1;
+                    xm_oe       <= 0;
+                    xip         <= mode_bits[5:4] == 2'b10;
+                end
+            end else if (state == st_wait) begin
+                // Waiting for read data.
+                xm_sclk     <= 0;
+                cnt         <= cnt - 1;
+                if (cnt == 0) begin
+                    state       <= st_data;
+                    cnt         <= 7;
+                end
+            end else begin
+                // Receiving read data.
+                xm_sclk     <= 0;
+                rword       <= rword_next;
+                cnt         <= cnt == 0 ? 7 : cnt - 1;
+            end
+        end
+    end
+    
+    // External bus logic.
+    assign xm_sio_out = state == st_init ? 4'b1111 : state == st_cmd ? {3'b111, sh[31]} : sh[31:28];
+endmodule
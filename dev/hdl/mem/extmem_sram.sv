@@ -6,6 +6,7 @@
 
 
 // Configurable 8-bit SRAM controller.
+// Accesses are pipelined at one byte per cycle, so bursts are served as back-to-back single accesses.
 module boa_extmem_sram#(
     // Address width of the SRAM.
     parameter sram_alen = 8
@@ -0,0 +1,133 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Configurable 8, 16, 32 or 64-bit asynchronous SRAM controller with byte enables, for a 32 or 64-bit bus.
+// Only the parts of a word with write enables set are written, so narrow stores take one cycle.
+// A new request is accepted in the same cycle the previous one completes; with an SRAM as wide as the bus, one access per cycle.
+module boa_extmem_sram_wide#(
+    // Address width of the SRAM in bytes.
+    parameter  sram_alen = 8,
+    // Data width of the SRAM, 8, 16, 32 or 64, at most dlen.
+    parameter  width     = 16,
+    // Data bus size, 32 or 64.
+    parameter  dlen      = 32,
+    // Number of SRAM accesses per bus word.
+    localparam parts     = dlen / width,
+    // Number of write enables.
+    localparam wes       = dlen / 8,
+    // Number of bytes per SRAM access.
+    localparam bpp       = width / 8,
+    // Number of byte address bits per SRAM access.
+    localparam bshift    = $clog2(bpp)
+)(
+    // CPU clock.
+    input  logic                      clk,
+    // Synchronous reset.
+    input  logic                      rst,
+    
+    // Internal memory bus.
+    boa_mem_bus.MEM                   bus,
+    
+    // Extmem read enable.
+    output logic                      xm_re,
+    // Extmem write enable.
+    output logic                      xm_we,
+    // Extmem byte enables.
+    output logic[bpp-1:0]             xm_be,
+    // Extmem address.
+    output logic[sram_alen-1:bshift]  xm_addr,
+    // Extmem write data.
+    output logic[width-1:0]           xm_wdata,
+    // Extmem read data.
+    input  logic[width-1:0]           xm_rdata
+);
+    // Read enable buffer.
+    logic                   ab_re;
+    // Write enable buffer.
+    logic[wes-1:0]          ab_we;
+    // Address buffer.
+    logic[sram_alen-1:2]    ab_addr;
+    // Write data buffer.
+    logic[dlen-1:0]         ab_wdata;
+    // Read data buffer.
+    logic[dlen-1:0]         rdata;
+    
+    // Access in progress.
+    logic                   busy;
+    // Part of the word being accessed.
+    logic[2:0]              part;
+    
+    // First part a new access needs.
+    logic[2:0]              first;
+    // Part the current access needs after this one.
+    logic[2:0]              next;
+    // The current access needs another part after this one.
+    logic                   more;
+    always @(*) begin
+        integer i;
+        first = 0;
+        next  = 'bx;
+        more  = 0;
+        for (i = parts-1; i >= 0; i = i - 1) begin
+            // Reads need every part, writes only those with enabled bytes.
+            if (bus.re || bus.we[i*bpp +: bpp] != 0) begin
+                first = i;
+            end
+            if (i > part && (ab_re || ab_we[i*bpp +: bpp] != 0)) begin
+                next = i;
+                more = 1;
+            end
+        end
+    end
+    
+    // Internal bus logic.
+    assign bus.ready = !busy || !more;
+    always @(*) begin
+        bus.rdata = rdata;
+        bus.rdata[part*width +: width] = xm_rdata;
+    end
+    always @(posedge clk) begin
+        if (rst) begin
+            // Reset.
+            ab_re       <= 0;
+            ab_we       <= 0;
+            ab_addr     <= 'bx;
+            ab_wdata    <= 'bx;
+            part        <= 0;
+            busy        <= 0;
+        end else if (busy && more) begin
+            // Extmem access in progress.
+            part        <= next;
+        end else if (bus.re || bus.we != 0) begin
+            // Initiate extmem access.
+            ab_re       <= bus.re;
+            ab_we       <= bus.we;
+            ab_addr     <= bus.addr;
+            ab_wdata    <= bus.wdata;
+            part        <= first;
+            busy        <= 1;
+        end else begin
+            // Idle.
+            ab_re       <= 0;
+            ab_we       <= 0;
+            ab_addr     <= 'bx;
+            ab_wdata    <= 'bx;
+            part        <= 0;
+            busy        <= 0;
+        end
+        if (busy && ab_re) begin
+            rdata[part*width +: width] <= xm_rdata;
+        end
+    end
+    
+    // External bus logic.
+    assign xm_addr  = ({ab_addr, 2'b00} >> bshift) + part;
+    assign xm_re    = busy && ab_re;
+    assign xm_we    = busy && ab_we != 0;
+    assign xm_be    = ab_re ? {bpp{1'b1}} : ab_we[part*bpp +: bpp];
+    assign xm_wdata = ab_wdata[part*width +: width];
+endmodule
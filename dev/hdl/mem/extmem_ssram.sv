@@ -0,0 +1,124 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Pipelined 32 or 64-bit synchronous SRAM controller, as wide as the bus.
+// The SRAM registers the address and the read data, so read data arrives two cycles after the address.
+// During a read burst, the address of the next beat is issued while the current beat is waiting for its data,
+// so after the first beat, one word is transferred per cycle. Writes complete in one cycle.
+module boa_extmem_ssram#(
+    // Address width of the SRAM in bytes.
+    parameter  sram_alen = 8,
+    // Data bus size, 32 or 64.
+    parameter  dlen      = 32,
+    // Number of write enables.
+    localparam wes       = dlen / 8,
+    // Number of byte address bits per SRAM word.
+    localparam dshift    = $clog2(wes)
+)(
+    // CPU clock.
+    input  logic                      clk,
+    // Synchronous reset.
+    input  logic                      rst,
+    
+    // Internal memory bus.
+    boa_mem_bus.MEM                   bus,
+    
+    // Extmem read enable.
+    output logic                      xm_re,
+    // Extmem write enable.
+    output logic                      xm_we,
+    // Extmem byte enables.
+    output logic[wes-1:0]             xm_be,
+    // Extmem address.
+    output logic[sram_alen-1:dshift]  xm_addr,
+    // Extmem write data.
+    output logic[dlen-1:0]            xm_wdata,
+    // Extmem read data.
+    input  logic[dlen-1:0]            xm_rdata
+);
+    // Read access waiting for data.
+    logic                     ab_re;
+    // Address of the read access waiting for data.
+    logic[sram_alen-1:dshift] ab_addr;
+    
+    // A read was issued to the SRAM one cycle ago.
+    logic                     p1_re;
+    // Address of the read issued one cycle ago.
+    logic[sram_alen-1:dshift] p1_addr;
+    // A read was issued to the SRAM two cycles ago; its data is available this cycle.
+    logic                     p2_re;
+    // Address of the read issued two cycles ago.
+    logic[sram_alen-1:dshift] p2_addr;
+    
+    // Address of the beat after the one presented in a burst.
+    logic[sram_alen-1:dshift] burst_next;
+    // Address presented in SRAM words.
+    wire [sram_alen-1:dshift] bus_addr    = bus.addr[sram_alen-1:dshift];
+    always @(*) begin
+        burst_next = bus_addr + 1;
+        if (bus.bwrap) begin
+            burst_next = (bus_addr & ~bus.blen) | (burst_next & bus.blen);
+        end
+    end
+    // The read presented was already issued to the SRAM.
+    wire                      issued      = p1_re && p1_addr == bus_addr;
+    // The read presented is part of a burst whose next beat can be issued.
+    wire                      predict     = bus.re && bus.blen != 0 && !bus.blast && !(p1_re && p1_addr == burst_next);
+    
+    // Internal bus logic.
+    assign bus.ready = !ab_re || (p2_re && p2_addr == ab_addr);
+    assign bus.rdata = xm_rdata;
+    always @(posedge clk) begin
+        if (rst) begin
+            ab_re   <= 0;
+            ab_addr <= 'bx;
+            p1_re   <= 0;
+            p1_addr <= 'bx;
+            p2_re   <= 0;
+            p2_addr <= 'bx;
+        end else begin
+            if (bus.ready) begin
+                ab_re   <= bus.re;
+                ab_addr <= bus_addr;
+            end
+            p1_re   <= xm_re;
+            p1_addr <= xm_addr;
+            p2_re   <= p1_re;
+            p2_addr <= p1_addr;
+        end
+    end
+    
+    // External bus logic.
+    assign xm_wdata = bus.wdata;
+    always @(*) begin
+        if (bus.ready && bus.we != 0) begin
+            // Write access.
+            xm_re   = 0;
+            xm_we   = 1;
+            xm_be   = bus.we;
+            xm_addr = bus_addr;
+        end else if (bus.ready && bus.re && !issued) begin
+            // New read access.
+            xm_re   = 1;
+            xm_we   = 0;
+            xm_be   = {wes{1'b1}};
+            xm_addr = bus_addr;
+        end else if (predict) begin
+            // Next beat of a read burst.
+            xm_re   = 1;
+            xm_we   = 0;
+            xm_be   = {wes{1'b1}};
+            xm_addr = burst_next;
+        end else begin
+            // Idle.
+            xm_re   = 0;
+            xm_we   = 0;
+            xm_be   = 'bx;
+            xm_addr = 'bx;
+        end
+    end
+endmodule
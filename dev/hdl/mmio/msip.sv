@@ -0,0 +1,43 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// CLINT-style machine software interrupt pending registers, one word per hart.
+// Bit 0 of the word at addr + 4 * hartid raises that hart's machine software interrupt; the other bits read as 0.
+module boa_peri_msip#(
+    // Base address to respond to.
+    parameter addr      = 32'h8000_0000,
+    // Number of harts.
+    parameter harts     = 1
+)(
+    // CPU clock.
+    input  logic            clk,
+    // Synchronous reset.
+    input  logic            rst,
+    
+    // Peripheral bus.
+    boa_mem_bus.MEM         bus,
+    
+    // Machine software interrupt pending for each hart.
+    output logic[harts-1:0] msip
+);
+    assign bus.ready = 1;
+    always @(posedge clk) begin
+        integer i;
+        if (rst) begin
+            msip      <= 0;
+            bus.rdata <= 0;
+        end else begin
+            bus.rdata <= 0;
+            for (i = 0; i < harts; i = i + 1) begin
+                if (bus.addr == addr[bus.alen-1:2] + i) begin
+                    if (bus.we[0]) msip[i] <= bus.wdata[0];
+                    bus.rdata <= msip[i];
+                end
+            end
+        end
+    end
+endmodule
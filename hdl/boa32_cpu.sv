@@ -7,11 +7,11 @@
 
 
 /*
-    Boa³² RV32IMC_Zicsr_Zifencei processor.
+    Boa³² RV32IMC_Zicsr_Zifencei processor, optionally with Zicbom, Zicbop, Zba, Zbb and Zbs.
     
     Pipeline:           5 stages (IF, ID, EX, MEM, WB)
     IPC:                0.33 min, ?.?? avg, 1.00 max
-    Interrupts:         16 external, 1 internal
+    Interrupts:         16 external, 1 internal, 1 software
     Privileges:         M-mode, U-mode
     Memory protection:  PMP
     
@@ -22,7 +22,12 @@
         0x303   mideleg     (0)
         0x304   mie
         0x305   mtvec
+        0x306   mcounteren  (if has_u_mode)
         0x310   mstatush    (0)
+        0x320   mcountinhibit (if has_zicntr)
+        0x323   mhpmevent3
+        ...     ...         ...
+        0x33f   mhpmevent31
         
         0x344   mip
         0x340   mscratch
@@ -36,6 +41,19 @@
         0xf14   mhartid     (parameter)
         0xf15   mconfigptr  (0)
         
+        0xb00   mcycle      (if has_zicntr)
+        0xb02   minstret    (if has_zicntr)
+        0xb03   mhpmcounter3
+        ...     ...         ...
+        0xb1f   mhpmcounter31
+        0xb80   mcycleh     (if has_zicntr)
+        ...     ...         ...
+        0xb9f   mhpmcounter31h
+        0xc00   cycle       (if has_zicntr)
+        0xc01   time        (if has_zicntr)
+        ...     ...         ...
+        0xc9f   hpmcounter31h
+        
         0x3a0   pmpcfg0
         ...     ...         ...
         0x3af   pmpcfg15
@@ -62,16 +80,52 @@ module boa32_cpu#(
     // Divider pipeline register distribution.
     // Only applicable if has_m is 1.
     parameter div_distr     = "center",
+    // Use an iterative divider with early termination instead; div_latency and div_distr are ignored.
+    // Only applicable if has_m is 1.
+    parameter div_iterative = 0,
+    // Iterative divider radix, 2 or 4.
+    // Only applicable if div_iterative is 1.
+    parameter div_radix     = 4,
     // Multiplier latency, 0 or 1.
     // Only applicable if has_m is 1.
     parameter mul_latency   = 0,
+    // Cache the last division result to fuse DIV and REM with the same operands.
+    // Only applicable if has_m is 1 and div_latency or div_iterative is not 0.
+    parameter div_fusion    = 1,
     // Enable additional latch in IF branch address.
     parameter if_branch_reg = 0,
+    // Number of 4-byte words in the IF L0 instruction buffer, 0 to disable.
+    parameter l0_depth      = 0,
+    // Number of branch target buffer entries, 0 to disable.
+    parameter btb_depth     = 0,
+    // Number of return address stack entries, 0 or a power of 2 of at least 2.
+    parameter ras_depth     = 0,
+    // Number of branch history table entries, 0 for static prediction.
+    parameter bht_depth     = 0,
+    // Number of global history bits hashed into the branch history table index.
+    // Only applicable if bht_depth is not 0.
+    parameter bht_history   = 0,
     // Enable additional latch for RMW AMOs.
     // Only applicable if has_a is 1.
     parameter rmw_amo_reg   = 0,
+    // Number of store buffer entries, 0 to disable.
+    parameter sbuf_depth    = 0,
+    // Base address of the memory-mapped I/O range, whose accesses the store buffer never buffers or reorders.
+    // The 4K page at cpummio is always treated as memory-mapped I/O.
+    // Only applicable if sbuf_depth is not 0.
+    parameter io_base       = 32'h0000_0000,
+    // Number of address bits in the memory-mapped I/O range, 0 for only the cpummio page.
+    // Only applicable if sbuf_depth is not 0.
+    parameter io_bits       = 0,
+    // Support misaligned loads and stores in hardware instead of raising alignment errors.
+    parameter misaligned    = 0,
     // Support configurability through misa.
     parameter misa_we       = 0,
+    // Support the cycle, time and instret counters (Zicntr).
+    parameter has_zicntr    = 0,
+    // Number of mhpmcounter event counters (Zihpm), 0 to 29.
+    // Only applicable if has_zicntr is 1.
+    parameter hpm_counters  = 0,
     // Support user mode.
     parameter has_u_mode    = 1,
     // Number of implemented PMPs, 0, 16 or 64.
@@ -83,7 +137,17 @@ module boa32_cpu#(
     // Support A (atomic memory operation) instructions.
     parameter has_a         = 1,
     // Support C (compressed) instructions.
-    parameter has_c         = 1
+    parameter has_c         = 1,
+    // Support cache-block management instructions (Zicbom).
+    parameter has_zicbom    = 0,
+    // Support cache-block prefetch hints (Zicbop).
+    parameter has_zicbop    = 0,
+    // Support address generation instructions (Zba).
+    parameter has_zba       = 0,
+    // Support basic bit-manipulation instructions (Zbb).
+    parameter has_zbb       = 0,
+    // Support single-bit instructions (Zbs).
+    parameter has_zbs       = 0
 )(
     // CPU clock.
     input  logic    clk,
@@ -103,6 +167,20 @@ module boa32_cpu#(
     output logic    fence_aq,
     // Perform an acquire instruction fence.
     output logic    fence_i,
+    // Invalidate the data cache block at cmo_addr.
+    // Always 0 if Zicbom isn't enabled.
+    output logic    cmo_inval,
+    // Write back the data cache block at cmo_addr.
+    // Always 0 if Zicbom isn't enabled.
+    output logic    cmo_clean,
+    // Prefetch the data cache block at cmo_addr.
+    // Always 0 if Zicbop isn't enabled.
+    output logic    cmo_prefetch,
+    // Cache-block operation address.
+    output logic[31:0] cmo_addr,
+    // A data fence or cache-block operation is in progress or is started by the request made this cycle.
+    // Must not depend on fence_i; FENCE.I is only issued when no other operation can be sent.
+    input  logic    cmo_busy,
     
     // Current memory access is an AMO (disable caches).
     // Always 0 if A extension isn't enabled.
@@ -112,7 +190,14 @@ module boa32_cpu#(
     boa_amo_bus.CPU resv_bus,
     
     // External interrupts 16 to 31.
-    input  logic[31:16] irq
+    input  logic[31:16] irq,
+    // Machine software interrupt (MSIP), raised by another hart.
+    input  logic        soft_irq,
+    
+    // Performance event: instruction cache miss.
+    input  logic        icache_miss,
+    // Performance event: data cache miss.
+    input  logic        dcache_miss
 );
     genvar x;
     
@@ -131,6 +216,8 @@ module boa32_cpu#(
     logic[31:1] if_id_pc;
     // IF/ID: Current instruction word.
     logic[31:0] if_id_insn;
+    // IF/ID: Predicted address of the next instruction.
+    logic[31:1] if_id_pred_pc;
     // IF/ID: Trap raised.
     logic       if_id_trap;
     // IF/ID: Trap cause.
@@ -227,13 +314,31 @@ module boa32_cpu#(
     logic       csr_status_mprv;
     // CSR status.MPP: M-mode previous privilege.
     logic[1:0]  csr_status_mpp;
-    // One of the PMPs is being locked.
-    logic       pmp_locking;
+    // A PMP CSR is being written.
+    logic       pmp_changing;
+    // Current value of mtime.
+    logic[63:0] mtime_val;
+    // An instruction is retired.
+    wire        retire = mem_wb_valid && !fw_stall_mem;
+    // Performance monitor events.
+    logic[`BOA_HPM_EVENTS-1:0] hpm_events;
     
     boa_csr_bus csr();
     boa_csr_ex_bus csr_ex();
-    boa_pmp_bus pmpbus[2]();
+    // PMP checking buses: IF, MEM and, for misaligned accesses, the second word in MEM.
+    boa_pmp_bus pmpbus[misaligned ? 3 : 2]();
+    // PMP checking bus for the second word of misaligned accesses in MEM.
+    boa_pmp_bus pmp_hi();
     generate
+        if (misaligned) begin: pmp_hi_conn
+            assign pmpbus[2].addr   = pmp_hi.addr;
+            assign pmpbus[2].m_mode = pmp_hi.m_mode;
+            assign pmp_hi.r         = pmpbus[2].r;
+            assign pmp_hi.w         = pmpbus[2].w;
+            assign pmp_hi.x         = pmpbus[2].x;
+        end else begin: pmp_hi_stub
+            boa_pmp_stub pmpstub_hi(pmp_hi);
+        end
         if (pmp_depth) begin: csr_with_pmp
             // CSR mux.
             boa_csr_bus csr_mux_bus[2]();
@@ -242,20 +347,25 @@ module boa32_cpu#(
             boa_pmp#(
                 .grain(pmp_grain),
                 .depth(pmp_depth),
-                .checkers(2)
+                .checkers(misaligned ? 3 : 2)
             ) pmp (
                 clk, rst,
                 csr_mux_bus[1], pmpbus,
-                pmp_locking
+                pmp_changing
             );
             // CSR register file.
             boa32_csrs#(
                 .hartid(hartid),
                 .misa_we(misa_we),
+                .has_zicntr(has_zicntr),
+                .hpm_counters(hpm_counters),
                 .has_u_mode(has_u_mode),
                 .has_m(has_m),
                 .has_a(has_a),
-                .has_c(has_c)
+                .has_c(has_c),
+                .has_zba(has_zba),
+                .has_zbb(has_zbb),
+                .has_zbs(has_zbs)
             ) csrs (
                 clk, rst,
                 csr_mux_bus[0], csr_ex,
@@ -263,21 +373,30 @@ module boa32_cpu#(
                 csr_status_mie,
                 csr_status_sie,
                 csr_status_mprv,
-                csr_status_mpp
+                csr_status_mpp,
+                cur_priv, mtime_val, retire, hpm_events
             );
         end else begin: csr_without_pmp
             // PMP stubs.
             boa_pmp_stub pmpstub0(pmpbus[0]);
             boa_pmp_stub pmpstub1(pmpbus[1]);
-            assign pmp_locking = 0;
+            if (misaligned) begin: pmp_hi_stub
+                boa_pmp_stub pmpstub2(pmpbus[2]);
+            end
+            assign pmp_changing = 0;
             // CSR register file.
             boa32_csrs#(
                 .hartid(hartid),
                 .misa_we(misa_we),
+                .has_zicntr(has_zicntr),
+                .hpm_counters(hpm_counters),
                 .has_u_mode(has_u_mode),
                 .has_m(has_m),
                 .has_a(has_a),
-                .has_c(has_c)
+                .has_c(has_c),
+                .has_zba(has_zba),
+                .has_zbb(has_zbb),
+                .has_zbs(has_zbs)
             ) csrs (
                 clk, rst,
                 csr, csr_ex,
@@ -285,7 +404,8 @@ module boa32_cpu#(
                 csr_status_mie,
                 csr_status_sie,
                 csr_status_mprv,
-                csr_status_mpp
+                csr_status_mpp,
+                cur_priv, mtime_val, retire, hpm_events
             );
         end
     endgenerate
@@ -337,21 +457,35 @@ module boa32_cpu#(
     logic       branch_predict;
     // Branch target address.
     logic[31:1] branch_target;
-    
-    // Predicted branch or unconditional control transfer.
+    // Address IF predicted to follow the instruction in ID.
+    logic[31:1] id_pred_pc;
+    // Jump that pushes a return address.
+    logic       is_call;
+    // Jump that pops a return address.
+    logic       is_ret;
+    // Address of the instruction after the one in ID.
+    wire [31:1] id_next_pc = id_ex_pc + (id_ex_ilen ? 2 : 1);
+    
+    // IF must be redirected for a predicted branch or unconditional control transfer.
     logic       fw_branch_predict;
     // Target address of control transfer.
     logic[31:1] fw_branch_target;
-    // Address of the next instruction.
-    logic[31:1] if_next_pc;
+    // Update the branch target buffer.
+    logic       fw_btb_we;
+    // Control transfer in ID is predicted taken.
+    logic       fw_btb_taken;
     // Mispredicted branch.
     logic       fw_branch_correct;
     // Branch correction address.
     logic[31:1] fw_branch_alt;
+    // Conditional branch resolved in EX.
+    logic       fw_branch_resolve;
+    // Resolved conditional branch was taken.
+    logic       fw_branch_taken;
     
     always @(posedge clk) begin
         if (is_branch) begin
-            fw_branch_alt <= fw_branch_predict ? if_next_pc : fw_branch_target;
+            fw_branch_alt <= branch_predict ? id_next_pc : branch_target;
         end
     end
     
@@ -359,6 +493,8 @@ module boa32_cpu#(
         if (fw_branch_correct && debug) begin
             $strobe("Branch correction to %x", fw_branch_alt<<1);
         end
+        fw_btb_we    = 0;
+        fw_btb_taken = 'bx;
         if (id_ex_valid && !fw_stall_id && is_xret) begin
             // MRET.
             csr_ex.ret          = 1;
@@ -368,21 +504,32 @@ module boa32_cpu#(
         end else if (id_ex_valid && is_jump) begin
             // JAL or JALR.
             csr_ex.ret          = 0;
-            fw_branch_predict   = 1;
+            fw_branch_predict   = id_pred_pc != branch_target;
             fw_branch_target    = branch_target;
+            fw_btb_we           = fw_branch_predict && !fw_stall_id;
+            fw_btb_taken        = 1;
             if (debug) $strobe("JAL(R) from %x to %x", id_ex_pc<<1, fw_branch_target<<1);
         end else if (id_ex_valid && is_branch) begin
             // Branch opcodes.
             csr_ex.ret          = 0;
-            fw_branch_predict   = branch_predict;
-            fw_branch_target    = branch_target;
+            fw_branch_target    = branch_predict ? branch_target : id_next_pc;
+            fw_branch_predict   = id_pred_pc != fw_branch_target;
+            fw_btb_we           = fw_branch_predict && !fw_stall_id;
+            fw_btb_taken        = branch_predict;
             if (debug) $strobe("BRANCH from %x to %x", id_ex_pc<<1, fw_branch_target<<1);
-        end else if (pmp_locking) begin
-            // PMP being locked.
+        end else if (pmp_changing) begin
+            // PMP being written.
             // Send instruction in ID back to IF to have its permissions checked again.
             csr_ex.ret          = 0;
             fw_branch_predict   = 1;
             fw_branch_target    = id_ex_pc;
+        end else if (id_ex_valid && id_pred_pc != id_next_pc) begin
+            // IF predicted a control transfer for an instruction that isn't one.
+            csr_ex.ret          = 0;
+            fw_branch_predict   = 1;
+            fw_branch_target    = id_next_pc;
+            fw_btb_we           = !fw_stall_id;
+            fw_btb_taken        = 0;
         end else begin
             // Not a control transfer.
             csr_ex.ret          = 0;
@@ -486,6 +633,8 @@ module boa32_cpu#(
     boa_stage_ex_fw  st_ex_fw (id_ex_insn,  use_rs1_ex,  use_rs2_ex);
     boa_stage_mem_fw st_mem_fw(ex_mem_insn, use_rs1_mem, use_rs2_mem);
     assign fence_i = is_fencei && !fw_stall_id;
+    // EX needs a result that cannot be forwarded yet.
+    wire   load_use = ((eq_ex_rs1_ex_rd || eq_ex_rs2_ex_rd || eq_bt_rs1_ex_rd) && !fw_rd_ex);
     always @(*) begin
         fw_stall_mem = mem_stall_req;
         fw_stall_ex  = ex_stall_req;
@@ -510,7 +659,7 @@ module boa32_cpu#(
             // Stall ID so that the current CSR write takes effect.
             fw_stall_id = 1;
         end
-        if ((eq_ex_rs1_ex_rd && !fw_rd_ex) || (eq_ex_rs2_ex_rd && !fw_rd_ex)) begin
+        if ((eq_ex_rs1_ex_rd || eq_ex_rs2_ex_rd) && !fw_rd_ex) begin
             // EX will next need something that has to be processed by MEM first.
             // Stall ID so that this instruction doesn't enter EX until a result is available.
             fw_stall_id = 1;
@@ -520,9 +669,9 @@ module boa32_cpu#(
             // Stall ID so that MEM will produce a result that may then be used by the branch target address.
             fw_stall_id = 1;
         end
-        if (is_fencei && (ex_mem_valid || mem_wb_valid)) begin
+        if (is_fencei && (ex_mem_valid || mem_wb_valid || st_mem.sbuf_busy)) begin
             // A fence.i instruction requires the rest of the pipeline to be emptied.
-            // Wait for the instructions in EX and MEM to either trap or finish.
+            // Wait for the instructions in EX and MEM to either trap or finish and for buffered stores to be written.
             fw_stall_id = 1;
         end
         if (misa_we && st_mem.csr_we && csr.addr == `RV_CSR_MISA) begin
@@ -542,6 +691,18 @@ module boa32_cpu#(
     end
     
     
+    /* ==== Performance monitor events ==== */
+    assign hpm_events[`BOA_HPM_NONE]        = 0;
+    assign hpm_events[`BOA_HPM_BRANCH_MISS] = fw_branch_correct;
+    assign hpm_events[`BOA_HPM_REDIRECT]    = fw_branch_predict && !fw_stall_id;
+    assign hpm_events[`BOA_HPM_ICACHE_MISS] = icache_miss;
+    assign hpm_events[`BOA_HPM_DCACHE_MISS] = dcache_miss;
+    assign hpm_events[`BOA_HPM_LOAD_USE]    = load_use && !fw_exception;
+    assign hpm_events[`BOA_HPM_DIV_STALL]   = st_ex.div_stall_req && !fw_exception;
+    assign hpm_events[`BOA_HPM_FENCE]       = fence_i || fence_aq || fence_rl;
+    assign hpm_events[`BOA_HPM_MEM_STALL]   = mem_stall_req && !fw_exception;
+    
+    
     /* ==== Exception logic ==== */
     assign csr_ex.ex_priv       = 1;
     assign csr_ex.ex_epc[31:1]  = mem_wb_pc[31:1];
@@ -555,7 +716,9 @@ module boa32_cpu#(
         csr_ex.irq_ip[31:16] <= irq[31:16];
         csr_ex.irq_ip[15:8]  <= 0;
         csr_ex.irq_ip[7]     <= mtime_irq;
-        csr_ex.irq_ip[6:0]   <= 0;
+        csr_ex.irq_ip[6:4]   <= 0;
+        csr_ex.irq_ip[3]     <= soft_irq;
+        csr_ex.irq_ip[2:0]   <= 0;
     end
     
     // Interrupt prioritization logic.
@@ -630,57 +793,62 @@ module boa32_cpu#(
     assign dbus.we           = dbus_out[0].we;
     assign dbus.addr         = dbus_out[0].addr;
     assign dbus.wdata        = dbus_out[0].wdata;
+    assign dbus.blen         = dbus_out[0].blen;
+    assign dbus.bwrap        = dbus_out[0].bwrap;
+    assign dbus.blast        = dbus_out[0].blast;
     assign dbus_out[0].ready = dbus.ready;
     assign dbus_out[0].rdata = dbus.rdata;
     
     // Machine-level timer.
-    boa_mtime#(.addr(cpummio)) mtime(clk, rtc_clk, rst, dbus_out[1], mtime_irq);
+    boa_mtime#(.addr(cpummio)) mtime(clk, rtc_clk, rst, dbus_out[1], mtime_irq, mtime_val);
     
     
     /* ==== Pipeline stages ==== */
-    boa_stage_if#(.entrypoint(entrypoint), .if_branch_reg(if_branch_reg)) st_if(
+    boa_stage_if#(.entrypoint(entrypoint), .if_branch_reg(if_branch_reg), .l0_depth(l0_depth), .btb_depth(btb_depth), .ras_depth(ras_depth)) st_if(
         clk, rst, clear_if, cur_priv,
         // Memory buses.
         pbus, pmpbus[0],
         // Pipeline output.
-        if_id_valid, if_id_pc, if_id_insn, if_id_trap, if_id_cause,
+        if_id_valid, if_id_pc, if_id_insn, if_id_pred_pc, if_id_trap, if_id_cause,
         // Instruction fetch fence.
         is_fencei,
         // Control transfer.
-        fw_branch_predict, fw_branch_target, if_next_pc, fw_branch_correct, fw_branch_alt, fw_exception, fw_tvec,
+        fw_branch_predict, fw_branch_target, fw_btb_we, id_ex_pc, fw_btb_taken,
+        id_ex_valid && is_call, id_ex_valid && is_ret, id_next_pc,
+        fw_branch_correct, fw_branch_alt, fw_exception, fw_tvec,
         // Data hazard avoicance.
-        fw_stall_if, pmp_locking
+        fw_stall_if, pmp_changing
     );
-    boa_stage_id#(.debug(debug), .has_m(has_m), .has_c(has_c)) st_id(
+    boa_stage_id#(.debug(debug), .has_m(has_m), .has_c(has_c), .has_zicbom(has_zicbom), .has_zba(has_zba), .has_zbb(has_zbb), .has_zbs(has_zbs), .bht_depth(bht_depth), .bht_history(bht_history)) st_id(
         clk, rst, clear_id, cur_priv,
         // Pipeline input.
-        if_id_valid && !fw_stall_if, if_id_pc, if_id_insn, if_id_trap && !fw_stall_if, if_id_cause,
+        if_id_valid && !fw_stall_if, if_id_pc, if_id_insn, if_id_pred_pc, if_id_trap && !fw_stall_if, if_id_cause,
         // Pipeline output.
         id_ex_valid, id_ex_pc, id_ex_insn, id_ex_ilen, id_ex_use_rd, id_ex_rs1_val, id_ex_rs2_val, id_ex_branch, id_ex_branch_predict, id_ex_trap, id_ex_cause,
         // Miscellaneous.
         is_fencei, csr_misa,
         // Control transfer.
-        is_xret, is_sret, is_jump, is_branch, branch_predict, branch_target,
+        is_xret, is_sret, is_jump, is_branch, branch_predict, branch_target, id_pred_pc, is_call, is_ret, fw_branch_resolve, fw_branch_taken,
         // Write-back.
         mem_wb_valid && mem_wb_use_rd && !fw_stall_mem, mem_wb_insn[11:7], mem_wb_rd_val,
         // Data hazard avoidance.
         fw_stall_id, use_rs1_bt, fw_rs1_bt, fw_in_bt
     );
-    boa_stage_ex#(.div_latency(div_latency), .div_distr(div_distr), .mul_latency(mul_latency), .has_m(has_m)) st_ex (
+    boa_stage_ex#(.div_latency(div_latency), .div_distr(div_distr), .div_iterative(div_iterative), .div_radix(div_radix), .mul_latency(mul_latency), .div_fusion(div_fusion), .has_m(has_m), .has_zicbop(has_zicbop), .has_zba(has_zba), .has_zbb(has_zbb), .has_zbs(has_zbs)) st_ex (
         clk, rst, clear_ex, cur_priv,
         // Pipeline input.
         id_ex_valid && !fw_stall_id, id_ex_pc, id_ex_insn, id_ex_ilen, id_ex_use_rd, fw_rs1_ex ? fw_in_rs1_ex : id_ex_rs1_val, fw_rs2_ex ? fw_in_rs2_ex : id_ex_rs2_val, id_ex_branch, id_ex_branch_predict, id_ex_trap && !fw_stall_id, id_ex_cause,
         // Pipeline output.
         ex_mem_valid, ex_mem_pc, ex_mem_insn, ex_mem_use_rd, ex_mem_rs1_val, ex_mem_rs2_val, ex_mem_trap, ex_mem_cause,
         // Data hazard avoidance.
-        fw_branch_correct, fw_stall_ex, fw_rd_ex, ex_stall_req
+        fw_branch_correct, fw_branch_resolve, fw_branch_taken, fw_stall_ex, fw_rd_ex, ex_stall_req
     );
-    boa_stage_mem#(.has_a(has_a), .rmw_amo_reg(rmw_amo_reg)) st_mem(
+    boa_stage_mem#(.has_a(has_a), .rmw_amo_reg(rmw_amo_reg), .has_zicbom(has_zicbom), .has_zicbop(has_zicbop), .sbuf_depth(sbuf_depth), .cpummio(cpummio), .io_base(io_base), .io_bits(io_bits), .misaligned(misaligned)) st_mem(
         clk, rst, clear_mem, cur_priv, csr_status_mprv ? csr_status_mpp : cur_priv,
         // Memory buses.
-        dbus_in, pmpbus[1], csr, amo_en, resv_bus,
-        // Data fence.
-        fence_rl, fence_aq,
+        dbus_in, pmpbus[1], pmp_hi, csr, amo_en, resv_bus,
+        // Data fence and cache-block operations.
+        fence_rl, fence_aq, cmo_inval, cmo_clean, cmo_prefetch, cmo_addr, cmo_busy,
         // Pipeline input.
         ex_mem_valid && !fw_stall_ex, ex_mem_pc, ex_mem_insn, ex_mem_use_rd, fw_rs1_mem ? fw_in_rs1_mem : ex_mem_rs1_val, fw_rs2_mem ? fw_in_rs2_mem : ex_mem_rs2_val, ex_mem_trap && !fw_stall_ex, ex_mem_cause,
         // Pipeline output.
@@ -708,6 +876,11 @@ module boa32_csrs#(
     parameter hartid        = 32'h0000_0000,
     // Support configurability through misa.
     parameter misa_we       = 1,
+    // Support the cycle, time and instret counters (Zicntr).
+    parameter has_zicntr    = 0,
+    // Number of mhpmcounter event counters (Zihpm), 0 to 29.
+    // Only applicable if has_zicntr is 1.
+    parameter hpm_counters  = 0,
     // Support user mode.
     parameter has_u_mode    = 0,
     // Support M (multiply/divide) instructions.
@@ -715,7 +888,13 @@ module boa32_csrs#(
     // Support A (atomic memory operation) instructions.
     parameter has_a         = 1,
     // Support C (compressed) instructions.
-    parameter has_c         = 1
+    parameter has_c         = 1,
+    // Support address generation instructions (Zba).
+    parameter has_zba       = 0,
+    // Support basic bit-manipulation instructions (Zbb).
+    parameter has_zbb       = 0,
+    // Support single-bit instructions (Zbs).
+    parameter has_zbs       = 0
 )(
     // CPU clock.
     input  logic        clk,
@@ -736,8 +915,18 @@ module boa32_csrs#(
     // CSR status.MPRV: Modify M-mode memory access privilege.
     output logic        csr_status_mprv,
     // CSR status.MPP: M-mode previous privilege.
-    output logic[1:0]   csr_status_mpp
+    output logic[1:0]   csr_status_mpp,
+    
+    // Current privilege mode.
+    input  logic[1:0]   cur_priv,
+    // Current value of mtime.
+    input  logic[63:0]  mtime,
+    // An instruction is retired.
+    input  logic        retire,
+    // Performance monitor events.
+    input  logic[`BOA_HPM_EVENTS-1:0] hpm_events
 );
+    genvar x;
     /* ==== CSR STORAGE ==== */
     // CSR misa: Enable A instructions.
     logic       csr_misa_a;
@@ -793,12 +982,24 @@ module boa32_csrs#(
     wire [31:0] csr_mhartid     = hartid;
     // CSR mconfigptr: M-mode configuration pointer.
     wire [31:0] csr_mconfigptr  = 0;
+    // CSR mcounteren: M-mode counter enable for U-mode.
+    logic[31:0] csr_mcounteren;
+    // CSR mcountinhibit: M-mode counter inhibit.
+    logic[31:0] csr_mcountinhibit;
+    // CSR mcycle: M-mode cycle counter.
+    logic[63:0] csr_mcycle;
+    // CSR minstret: M-mode instructions retired counter.
+    logic[63:0] csr_minstret;
+    // CSR mhpmcounter: M-mode event counters.
+    logic[63:0] csr_mhpmcounter[3:31];
+    // CSR mhpmevent: M-mode event selectors.
+    logic[31:0] csr_mhpmevent[3:31];
     
     
     /* ==== CSR misa value ==== */
     // Instruction set extensions.
     assign csr_misa[0]     = csr_misa_a;
-    assign csr_misa[1]     = 0;
+    assign csr_misa[1]     = has_zba && has_zbb && has_zbs; // B
     assign csr_misa[2]     = csr_misa_c;
     assign csr_misa[7:3]   = 0;
     assign csr_misa[8]     = 1; // I
@@ -896,12 +1097,135 @@ module boa32_csrs#(
     assign csr_mimpid[7:4]   = 1;
     // Semantic versioning MAJOR.
     assign csr_mimpid[15:8]  = 2;
+    // Bit-manipulation extensions: Zba, Zbb and Zbs.
+    assign csr_mimpid[16]    = has_zba;
+    assign csr_mimpid[17]    = has_zbb;
+    assign csr_mimpid[18]    = has_zbs;
     // Reserved.
-    assign csr_mimpid[30:16] = 0;
+    assign csr_mimpid[30:19] = 0;
     // Is a fork of Boa-RISC-V.
     assign csr_mimpid[31]    = 0;
     
     
+    /* ==== Counter logic ==== */
+    // Counter CSR exists.
+    logic       cnt_exists;
+    // Counter CSR is read-only.
+    logic       cnt_rdonly;
+    // Counter CSR read data.
+    logic[31:0] cnt_rdata;
+    
+    generate
+        if (has_zicntr) begin: zicntr
+            // Implemented mcountinhibit bits.
+            localparam logic[31:0] inhibit_mask = ((64'h1 << (hpm_counters + 3)) - 1) & ~64'h2;
+            // Implemented mcounteren bits.
+            localparam logic[31:0] enable_mask  = has_u_mode ? (64'h1 << (hpm_counters + 3)) - 1 : 0;
+            
+            // Base counters.
+            always @(posedge clk) begin
+                if (rst) begin
+                    csr_mcounteren    <= 0;
+                    csr_mcountinhibit <= 0;
+                    csr_mcycle        <= 0;
+                    csr_minstret      <= 0;
+                end else begin
+                    if (csr.we && csr.addr == `RV_CSR_MCOUNTEREN) begin
+                        csr_mcounteren    <= csr.wdata & enable_mask;
+                    end
+                    if (csr.we && csr.addr == `RV_CSR_MCOUNTINHIBIT) begin
+                        csr_mcountinhibit <= csr.wdata & inhibit_mask;
+                    end
+                    if (csr.we && csr.addr == `RV_CSR_MCYCLE) begin
+                        csr_mcycle[31:0]    <= csr.wdata;
+                    end else if (csr.we && csr.addr == `RV_CSR_MCYCLEH) begin
+                        csr_mcycle[63:32]   <= csr.wdata;
+                    end else if (!csr_mcountinhibit[0]) begin
+                        csr_mcycle          <= csr_mcycle + 1;
+                    end
+                    if (csr.we && csr.addr == `RV_CSR_MINSTRET) begin
+                        csr_minstret[31:0]  <= csr.wdata;
+                    end else if (csr.we && csr.addr == `RV_CSR_MINSTRETH) begin
+                        csr_minstret[63:32] <= csr.wdata;
+                    end else if (!csr_mcountinhibit[2] && retire) begin
+                        csr_minstret        <= csr_minstret + 1;
+                    end
+                end
+            end
+            
+            // Event counters.
+            for (x = 3; x < 32; x = x + 1) begin: hpm
+                if (x < hpm_counters + 3) begin: counter
+                    logic[63:0] count;
+                    logic[31:0] event_sel;
+                    assign csr_mhpmcounter[x] = count;
+                    assign csr_mhpmevent[x]   = event_sel;
+                    always @(posedge clk) begin
+                        if (rst) begin
+                            count     <= 0;
+                            event_sel <= `BOA_HPM_NONE;
+                        end else begin
+                            if (csr.we && csr.addr == `RV_CSR_MHPMEVENT3 + x - 3) begin
+                                event_sel <= csr.wdata < `BOA_HPM_EVENTS ? csr.wdata : `BOA_HPM_NONE;
+                            end
+                            if (csr.we && csr.addr == `RV_CSR_MHPMCOUNTER3 + x - 3) begin
+                                count[31:0]  <= csr.wdata;
+                            end else if (csr.we && csr.addr == `RV_CSR_MHPMCOUNTER3H + x - 3) begin
+                                count[63:32] <= csr.wdata;
+                            end else if (!csr_mcountinhibit[x] && hpm_events[event_sel]) begin
+                                count        <= count + 1;
+                            end
+                        end
+                    end
+                end else begin: stub
+                    assign csr_mhpmcounter[x] = 0;
+                    assign csr_mhpmevent[x]   = `BOA_HPM_NONE;
+                end
+            end
+            
+            // Counter read logic.
+            // Unimplemented event counters and selectors are read-only zero.
+            logic[63:0] value;
+            always @(*) begin
+                case (csr.addr[4:0])
+                    0:       value = csr_mcycle;
+                    1:       value = mtime;
+                    2:       value = csr_minstret;
+                    default: value = csr_mhpmcounter[csr.addr[4:0]];
+                endcase
+                if ((csr.addr[11:8] == 4'hb || csr.addr[11:8] == 4'hc) && csr.addr[6:5] == 0) begin
+                    // mcycle, minstret and mhpmcounter; cycle, time, instret and hpmcounter.
+                    // The latter are only accessible to U-mode if enabled in mcounteren.
+                    cnt_exists = csr.addr[11:8] == 4'hc ? cur_priv == 3 || csr_mcounteren[csr.addr[4:0]] : csr.addr[4:0] != 1;
+                    cnt_rdonly = csr.addr[11:8] == 4'hc;
+                    cnt_rdata  = csr.addr[7] ? value[63:32] : value[31:0];
+                end else if (csr.addr == `RV_CSR_MCOUNTINHIBIT) begin
+                    cnt_exists = 1;
+                    cnt_rdonly = 0;
+                    cnt_rdata  = csr_mcountinhibit;
+                end else if (csr.addr[11:5] == `RV_CSR_MCOUNTINHIBIT >> 5 && csr.addr[4:0] >= 3) begin
+                    // mhpmevent.
+                    cnt_exists = 1;
+                    cnt_rdonly = 0;
+                    cnt_rdata  = csr_mhpmevent[csr.addr[4:0]];
+                end else begin
+                    cnt_exists = 0;
+                    cnt_rdonly = 'bx;
+                    cnt_rdata  = 'bx;
+                end
+            end
+        end else begin: no_zicntr
+            assign csr_mcounteren    = 0;
+            assign csr_mcountinhibit = 0;
+            assign csr_mcycle        = 'bx;
+            assign csr_minstret      = 'bx;
+            assign cnt_exists        = 0;
+            assign cnt_rdonly        = 'bx;
+            assign cnt_rdata         = 'bx;
+        end
+    endgenerate
+    
+    
     /* ==== CSR ACCESS LOGIC ==== */
     assign csr.priv         = 'bx;
     assign ex.ret_epc       = csr_mepc;
@@ -920,6 +1244,7 @@ module boa32_csrs#(
             `RV_CSR_MIDELEG:    begin csr.exists = 1; csr.rdonly = 0; csr.rdata = csr_mideleg; end
             `RV_CSR_MIE:        begin csr.exists = 1; csr.rdonly = 0; csr.rdata = csr_mie; end
             `RV_CSR_MTVEC:      begin csr.exists = 1; csr.rdonly = 0; csr.rdata[31:2] = csr_mtvec[31:2]; csr.rdata[1:0] = 0; end
+            `RV_CSR_MCOUNTEREN: begin csr.exists = has_u_mode; csr.rdonly = 0; csr.rdata = csr_mcounteren; end
             `RV_CSR_MSTATUSH:   begin csr.exists = 1; csr.rdonly = 0; csr.rdata = csr_mstatush; end
             `RV_CSR_MIP:        begin csr.exists = 1; csr.rdonly = 0; csr.rdata = csr_mip; end
             `RV_CSR_MSCRATCH:   begin csr.exists = 1; csr.rdonly = 0; csr.rdata = csr_mscratch; end
@@ -931,7 +1256,7 @@ module boa32_csrs#(
             `RV_CSR_MIMPID:     begin csr.exists = 1; csr.rdonly = 1; csr.rdata = csr_mimpid; end
             `RV_CSR_MHARTID:    begin csr.exists = 1; csr.rdonly = 1; csr.rdata = csr_mhartid; end
             `RV_CSR_MCONFIGPTR: begin csr.exists = 1; csr.rdonly = 1; csr.rdata = csr_mconfigptr; end
-            default:            begin csr.exists = 0; csr.rdonly = 'bx; csr.rdata = 'bx; end
+            default:            begin csr.exists = cnt_exists; csr.rdonly = cnt_rdonly; csr.rdata = cnt_rdata; end
         endcase
     end
     
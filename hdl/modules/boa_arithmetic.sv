@@ -69,6 +69,153 @@ endmodule
 
 
 
+// Iterative divider with early termination.
+// Retires 1 (radix 2) or 2 (radix 4) quotient bits per cycle, starting at the highest quotient bit that can be set.
+// Division by zero, by one and with a dividend smaller than the divisor complete without any iterations.
+module boa_div_iterative#(
+    // Divider radix, 2 or 4.
+    parameter radix = 4
+)(
+    // Divider clock.
+    input  logic        clk,
+    // Synchronous reset.
+    input  logic        rst,
+    
+    // Division requested; operands must be stable until acknowledged.
+    input  logic        req,
+    // Result consumed or request cancelled.
+    input  logic        ack,
+    // Perform unsigned division.
+    input  logic        u,
+    
+    // Left-hand side.
+    input  logic[31:0]  lhs,
+    // Right-hand side.
+    input  logic[31:0]  rhs,
+    // Result valid.
+    output logic        valid,
+    // Division result.
+    output logic[31:0]  div_res,
+    // Modulo result.
+    output logic[31:0]  mod_res
+);
+    // Count leading zeroes.
+    function automatic logic[5:0] clz(input logic[31:0] value);
+        integer i;
+        clz = 32;
+        for (i = 0; i < 32; i = i + 1) begin
+            if (value[i]) clz = 31 - i;
+        end
+    endfunction
+    
+    // Correct sign of inputs.
+    wire [31:0] neg_lhs  = ~lhs + 1;
+    wire        sign_lhs = !u && lhs[31];
+    wire [31:0] tmp_lhs  = sign_lhs ? neg_lhs : lhs;
+    wire [31:0] neg_rhs  = ~rhs + 1;
+    wire        sign_rhs = !u && rhs[31];
+    wire [31:0] tmp_rhs  = sign_rhs ? neg_rhs : rhs;
+    
+    // Fast paths.
+    wire        fast_0   = rhs == 0;
+    wire        fast_1   = tmp_rhs == 1;
+    wire        fast_lt  = tmp_lhs < tmp_rhs;
+    wire        fast     = fast_0 || fast_1 || fast_lt;
+    
+    // Number of quotient bits that can be set, minus one.
+    wire [5:0]  first    = clz(tmp_rhs) - clz(tmp_lhs);
+    
+    // Iterating.
+    logic       busy;
+    // Result registered.
+    logic       done;
+    // Partial remainder.
+    logic[31:0] r_rem;
+    // Shifted divisor.
+    logic[31:0] r_dsh;
+    // Partial quotient.
+    logic[31:0] r_quot;
+    // Remaining quotient bits.
+    logic[5:0]  r_steps;
+    // Negate the quotient.
+    logic       r_sign_q;
+    // Negate the remainder.
+    logic       r_sign_r;
+    // Registered division result.
+    logic[31:0] r_div;
+    // Registered modulo result.
+    logic[31:0] r_mod;
+    
+    // Iteration logic.
+    wire        ge1      = r_rem >= r_dsh;
+    wire [31:0] s1_rem   = ge1 ? r_rem - r_dsh : r_rem;
+    wire [31:0] s1_dsh   = r_dsh >> 1;
+    wire [31:0] s1_quot  = {r_quot[30:0], ge1};
+    wire        ge2      = s1_rem >= s1_dsh;
+    wire [31:0] s2_rem   = ge2 ? s1_rem - s1_dsh : s1_rem;
+    wire [31:0] s2_dsh   = s1_dsh >> 1;
+    wire [31:0] s2_quot  = {s1_quot[30:0], ge2};
+    wire        two      = radix == 4 && r_steps >= 2;
+    wire [31:0] n_rem    = two ? s2_rem  : s1_rem;
+    wire [31:0] n_dsh    = two ? s2_dsh  : s1_dsh;
+    wire [31:0] n_quot   = two ? s2_quot : s1_quot;
+    wire [5:0]  n_steps  = r_steps - (two ? 2 : 1);
+    
+    // Output logic.
+    always @(*) begin
+        if (done) begin
+            valid   = 1;
+            div_res = r_div;
+            mod_res = r_mod;
+        end else if (!busy && req && fast_0) begin
+            valid   = 1;
+            div_res = 32'hffff_ffff;
+            mod_res = lhs;
+        end else if (!busy && req && fast_1) begin
+            valid   = 1;
+            div_res = (sign_lhs ^ sign_rhs) ? ~tmp_lhs + 1 : tmp_lhs;
+            mod_res = 0;
+        end else if (!busy && req && fast_lt) begin
+            valid   = 1;
+            div_res = 0;
+            mod_res = lhs;
+        end else begin
+            valid   = 0;
+            div_res = 'bx;
+            mod_res = 'bx;
+        end
+    end
+    
+    // State machine.
+    always @(posedge clk) begin
+        if (rst || ack) begin
+            busy     <= 0;
+            done     <= 0;
+        end else if (busy) begin
+            r_rem    <= n_rem;
+            r_dsh    <= n_dsh;
+            r_quot   <= n_quot;
+            r_steps  <= n_steps;
+            if (n_steps == 0) begin
+                busy  <= 0;
+                done  <= 1;
+                r_div <= r_sign_q ? ~n_quot + 1 : n_quot;
+                r_mod <= r_sign_r ? ~n_rem  + 1 : n_rem;
+            end
+        end else if (req && !done && !fast) begin
+            busy     <= 1;
+            r_rem    <= tmp_lhs;
+            r_dsh    <= tmp_rhs << first;
+            r_quot   <= 0;
+            r_steps  <= first + 1;
+            r_sign_q <= sign_lhs ^ sign_rhs;
+            r_sign_r <= sign_lhs;
+        end
+    end
+endmodule
+
+
+
 /* verilator lint_off UNOPTFLAT */
 /* Also: really, verilator? */
 
@@ -16,13 +16,16 @@ interface boa_amo_bus#(
     logic           req;
     // CPU -> MEM: Reservation address.
     logic[alen-1:2] addr;
+    // CPU -> MEM: The request is for an SC, whose write is presented in the same cycle if the reservation is valid.
+    // It is repeated every cycle until the write is accepted, and the write is dropped as soon as the reservation is not valid.
+    logic           sc;
     // MEM -> CPU: Reservation valid.
     logic           valid;
     
     // Directions from CPU perspective.
-    modport CPU (output req, addr, input valid);
+    modport CPU (output req, addr, sc, input valid);
     // Directions from MEM perspective.
-    modport MEM (output valid, input req, addr);
+    modport MEM (output valid, input req, addr, sc);
 endinterface
 
 // Boa atomic memory operation terminator.
@@ -34,6 +37,7 @@ endmodule
 
 
 // Single reservation boa atomic memory operation controller.
+// A write to the reserved address on any watched bus invalidates the reservation.
 module boa_amo_ctl_1#(
     // Address bus size, at least 8.
     parameter alen = 32,
@@ -42,7 +46,10 @@ module boa_amo_ctl_1#(
     // Number of memory buses to watch, 2+.
     parameter watchers  = 2,
     // Arbitration strategy.
-    parameter arbiter   = `BOA_ARBITER_RR
+    parameter arbiter   = `BOA_ARBITER_RR,
+    // The first cpus watched buses are the data buses of the CPUs in the same order;
+    // a CPU's own writes, including the SC, then don't invalidate its reservation.
+    parameter cpu_watch = 0
 )(
     // CPU clock.
     input  logic        clk,
@@ -67,10 +74,13 @@ module boa_amo_ctl_1#(
     logic[alen-1:0] req_addr[cpus];
     // Current reservation.
     logic[cpus-1:0] cur;
-    // Next reservation.
+    // Next arbitration result.
     logic[cpus-1:0] next;
+    // Next reservation; the current one is kept while it is requested.
+    logic[cpus-1:0] grant;
     
     // Arbitration.
+    assign grant = (cur & req) != 0 ? cur : next;
     generate
         for (x = 0; x < cpus; x = x + 1) begin
             assign req[x]      = amo[x].req;
@@ -80,9 +90,11 @@ module boa_amo_ctl_1#(
             boa_arbiter_rr#(cpus) arbiter(clk, rst, req, cur, next);
         end else if (arbiter == `BOA_ARBITER_STATIC) begin: arbiter_static
             boa_arbiter_static#(cpus) arbiter(clk, rst, req, cur, next);
+        end else if (arbiter == `BOA_ARBITER_AGING) begin: arbiter_aging
+            boa_arbiter_aging#(cpus) arbiter(clk, rst, req, cur, next);
         end
     endgenerate
-    boa_sel_enc#(cpus, alen) enc(next, req_addr, addr);
+    boa_sel_enc#(cpus, alen) enc(grant, req_addr, addr);
     
     // Matching write access detected.
     logic[watchers-1:0] wmatch_mask;
@@ -92,7 +104,11 @@ module boa_amo_ctl_1#(
     assign wmatch = wmatch_mask != 0;
     generate
         for (x = 0; x < watchers; x = x + 1) begin
-            assign wmatch_mask[x] = watch[x].we != 0 && watch[x].addr == addr;
+            if (cpu_watch && x < cpus) begin: own
+                assign wmatch_mask[x] = watch[x].we != 0 && watch[x].addr == addr && !grant[x];
+            end else begin: other
+                assign wmatch_mask[x] = watch[x].we != 0 && watch[x].addr == addr;
+            end
         end
     endgenerate
     
@@ -101,7 +117,7 @@ module boa_amo_ctl_1#(
     assign valid = valid_mask != 0;
     generate
         for (x = 0; x < cpus; x = x + 1) begin
-            assign amo[x].valid  = req[x] && next[x] && !wmatch;
+            assign amo[x].valid  = req[x] && grant[x] && !wmatch;
             assign valid_mask[x] = amo[x].valid;
         end
     endgenerate
@@ -111,15 +127,128 @@ module boa_amo_ctl_1#(
         if (rst) begin
             cur     <= 1;
         end else if (valid) begin
-            cur     <= next;
+            cur     <= grant;
+        end
+    end
+endmodule
+
+// Multiple reservation boa atomic memory operation controller.
+// Every CPU has its own reservation, which is only invalidated by watched writes to its reservation granule.
+// If cpu_watch is set, a write by another CPU in the same cycle makes an SC fail, unless that write is itself an SC.
+// Because an SC keeps requesting until its write is accepted, this holds for writes that a shared bus serves first too:
+// they are presented while the SC waits, and the SC write is dropped.
+// SCs to the same granule in the same cycle are decided by a rotating priority that does not depend on the writes,
+// which keeps the SCs of different CPUs from depending on each other combinationally.
+module boa_amo_ctl_n#(
+    // Address bus size, at least 8.
+    parameter alen      = 32,
+    // Number of CPUs, 1+.
+    parameter cpus      = 2,
+    // Number of memory buses to watch, 1+.
+    parameter watchers  = 2,
+    // Log2 of the reservation granule size in bytes, at least 2.
+    parameter grain     = 2,
+    // The first cpus watched buses are the data buses of the CPUs in the same order;
+    // a CPU's own writes, including the SC, then don't invalidate its reservation.
+    parameter cpu_watch = 0,
+    // Number of bits in a CPU index.
+    localparam ilen     = cpus > 1 ? $clog2(cpus) : 1
+)(
+    // CPU clock.
+    input  logic        clk,
+    // Synchronous reset.
+    input  logic        rst,
+    
+    // CPU AMO ports.
+    boa_amo_bus.MEM     amo[cpus],
+    // WATCH MEM ports.
+    boa_mem_bus.WATCH   watch[watchers]
+);
+    genvar x, y;
+    
+    // CPU that wins SC ties this cycle; the next CPU wins them after a tie.
+    logic[ilen-1:0] first;
+    // Positions of the CPUs in the SC priority order, 0 being the highest.
+    logic[ilen:0]   rank[cpus];
+    // CPUs that present an SC for a reservation that is not already invalidated.
+    logic[cpus-1:0] sc_live;
+    // CPUs whose SC lost a tie this cycle.
+    logic[cpus-1:0] sc_lost;
+    
+    always @(posedge clk) begin
+        if (rst) begin
+            first   <= 0;
+        end else if (sc_lost != 0) begin
+            first   <= first == cpus - 1 ? 0 : first + 1;
         end
     end
+    
+    generate
+        for (x = 0; x < cpus; x = x + 1) begin: resv
+            // Watched writes to the granule that invalidate the reservation in this cycle.
+            logic[watchers-1:0] kill_now;
+            // Watched writes to the granule that invalidate the reservation from the next cycle.
+            logic[watchers-1:0] kill_late;
+            // Higher-priority SCs to the granule in this cycle.
+            logic[cpus-1:0]     sc_beat;
+            for (y = 0; y < watchers; y = y + 1) begin: w
+                wire hit = watch[y].we != 0 && watch[y].addr[alen-1:grain] == amo[x].addr[alen-1:grain];
+                if (cpu_watch && y == x) begin: own
+                    assign kill_now[y]  = 0;
+                    assign kill_late[y] = 0;
+                end else if (cpu_watch && y < cpus) begin: cpu
+                    // The SC of another CPU to the same granule is the only write of that CPU that depends on its reservation;
+                    // it is decided by the SC priority instead.
+                    wire sc_same = amo[y].req && amo[y].sc && amo[y].addr[alen-1:grain] == amo[x].addr[alen-1:grain];
+                    assign kill_now[y]  = hit && !sc_same;
+                    assign kill_late[y] = hit && sc_same;
+                end else begin: other
+                    assign kill_now[y]  = hit;
+                    assign kill_late[y] = 0;
+                end
+            end
+            for (y = 0; y < cpus; y = y + 1) begin: sc
+                if (cpu_watch && y != x) begin: cpu
+                    assign sc_beat[y] = sc_live[y] && rank[y] < rank[x]
+                                     && amo[y].addr[alen-1:grain] == amo[x].addr[alen-1:grain];
+                end else begin: own
+                    assign sc_beat[y] = 0;
+                end
+            end
+            
+            // Address requested last cycle.
+            logic[alen-1:2] p_addr;
+            // The reservation at p_addr was invalidated while it was requested.
+            logic           dead;
+            // The reservation is not invalidated by earlier writes.
+            wire            alive   = !(dead && amo[x].addr == p_addr);
+            assign rank[x]      = x >= first ? x - first : x + cpus - first;
+            assign sc_live[x]   = amo[x].req && amo[x].sc && alive;
+            assign sc_lost[x]   = sc_live[x] && sc_beat != 0;
+            assign amo[x].valid = amo[x].req && kill_now == 0 && sc_beat == 0 && alive;
+            always @(posedge clk) begin
+                if (rst) begin
+                    p_addr  <= 'bx;
+                    dead    <= 0;
+                end else begin
+                    p_addr  <= amo[x].addr;
+                    dead    <= amo[x].req && ((kill_now | kill_late) != 0 || !alive);
+                end
+            end
+        end
+    endgenerate
 endmodule
 
 
 
 // Standard Boa memory interface.
 // Latency: 1 clock cycle.
+// Addresses are in 4-byte units; on a 64-bit bus, they are aligned to 8 bytes and the write enables cover all 8 bytes.
+// A burst is a sequence of accesses that each use the normal handshake and carry their own address,
+// presented back to back without idle cycles in between and all with the same blen and bwrap.
+// A MEM that ignores the burst signals sees them as independent accesses;
+// one that supports them may keep a transaction open until the last beat.
+// RMW AMOs are presented as a burst of a read and a write to the same address, so that they are not split by a demultiplexer.
 interface boa_mem_bus#(
     // Address bus size, at least 8.
     parameter alen = 32,
@@ -136,17 +265,23 @@ interface boa_mem_bus#(
     logic[alen-1:2] addr;
     // CPU -> MEM: Write data.
     logic[dlen-1:0] wdata;
+    // CPU -> MEM: Burst length minus one, 0 for single accesses; up to 16 beats.
+    logic[3:0]      blen;
+    // CPU -> MEM: Burst addresses wrap at a (blen+1)-beat boundary instead of incrementing.
+    logic           bwrap;
+    // CPU -> MEM: Last beat of a burst, only meaningful if blen is nonzero.
+    logic           blast;
     // MEM -> CPU: Ready, must be 1 if not selected.
     logic           ready;
     // MEM -> CPU: Read data.
     logic[dlen-1:0] rdata;
     
     // Directions from CPU perspective.
-    modport CPU   (output re, we, addr, wdata, input ready, rdata);
+    modport CPU   (output re, we, addr, wdata, blen, bwrap, blast, input ready, rdata);
     // Directions from MEM perspective.
-    modport MEM   (output ready, rdata, input re, we, addr, wdata);
+    modport MEM   (output ready, rdata, input re, we, addr, wdata, blen, bwrap, blast);
     // Directions from WATCH perspective.
-    modport WATCH (input re, we, addr, wdata, ready, rdata);
+    modport WATCH (input re, we, addr, wdata, blen, bwrap, blast, ready, rdata);
 endinterface
 
 // Boa memory bus connector.
@@ -158,6 +293,9 @@ module boa_mem_connector(
     assign cpu.we       = mem.we;
     assign cpu.addr     = mem.addr;
     assign cpu.wdata    = mem.wdata;
+    assign cpu.blen     = mem.blen;
+    assign cpu.bwrap    = mem.bwrap;
+    assign cpu.blast    = mem.blast;
     assign mem.ready    = cpu.ready;
     assign mem.rdata    = cpu.rdata;
 endmodule
@@ -191,6 +329,9 @@ module boa_mem_cmap#(
     assign cpu.addr[alen_lo-1:2]                = mem.addr[alen_lo-1:2];
     assign cpu.addr[alen_lo+alen_hi-1:alen_lo]  = mem.addr[bpos_hi+alen_hi-1:bpos_hi];
     assign cpu.wdata    = mem.wdata;
+    assign cpu.blen     = mem.blen;
+    assign cpu.bwrap    = mem.bwrap;
+    assign cpu.blast    = mem.blast;
     assign mem.ready    = cpu.ready;
     assign mem.rdata    = cpu.rdata;
 endmodule
@@ -221,6 +362,9 @@ module mem_mem_amap(
     assign              cpu.we      = sel ? mem.we : 0;
     assign              cpu.addr    = mem.addr;
     assign              cpu.wdata   = mem.wdata;
+    assign              cpu.blen    = mem.blen;
+    assign              cpu.bwrap   = mem.bwrap;
+    assign              cpu.blast   = mem.blast;
     assign              mem.ready   = psel && cpu.ready;
     assign              mem.rdata   = cpu.rdata;
     
@@ -254,6 +398,9 @@ module boa_mem_overlay#(
             assign mem[x].we     = cpu.we;
             assign mem[x].addr   = cpu.addr;
             assign mem[x].wdata  = cpu.wdata;
+            assign mem[x].blen   = cpu.blen;
+            assign mem[x].bwrap  = cpu.bwrap;
+            assign mem[x].blast  = cpu.blast;
             assign ready_mask[x] = mem[x].ready;
             assign rdata_mask[x] = mem[x].rdata;
         end
@@ -318,6 +465,9 @@ module boa_mem_mux#(
             assign mem[x].we    = sel[x] ? cpu.we : 0;
             assign mem[x].addr  = cpu.addr;
             assign mem[x].wdata = cpu.wdata;
+            assign mem[x].blen  = cpu.blen;
+            assign mem[x].bwrap = cpu.bwrap;
+            assign mem[x].blast = cpu.blast;
         end
     endgenerate
     logic           ready_mask[mems];
@@ -349,6 +499,7 @@ endmodule
 
 
 // Round-robin arbiter.
+// Picks the first requesting port after the current one.
 module boa_arbiter_rr#(
     // Number of ports, at least 2.
     parameter ports = 2
@@ -367,16 +518,6 @@ module boa_arbiter_rr#(
 );
     genvar i;
     
-    logic hold;
-    
-    always @(posedge clk) begin
-        if (rst) begin
-            hold <= 0;
-        end else begin
-            hold <= req != 0;
-        end
-    end
-    
     /* verilator lint_off UNOPTFLAT */
     logic[ports*2-1:0] arbiter;
     assign arbiter[0] = 0;
@@ -394,12 +535,13 @@ module boa_arbiter_rr#(
     
     generate
         for (i = 0; i < ports; i = i + 1) begin
-            assign next[i] = hold ? cur[i] : (arbiter[i] || arbiter[i+ports]) && req[i];
+            assign next[i] = (arbiter[i] || arbiter[i+ports]) && req[i];
         end
     endgenerate
 endmodule
 
 // Static prioritization arbiter.
+// Picks the lowest requesting port.
 module boa_arbiter_static#(
     // Number of ports, at least 2.
     parameter ports = 2
@@ -418,36 +560,93 @@ module boa_arbiter_static#(
 );
     genvar x;
     
-    logic hold;
+    generate
+        assign next[0] = req[0];
+        for (x = 1; x < ports; x = x + 1) begin
+            assign next[x] = req[x] && req[x-1:0] == 0;
+        end
+    endgenerate
+endmodule
+
+// Static prioritization arbiter with aging.
+// Picks the lowest requesting port, unless a port has been requesting without being the current one for max_age cycles;
+// then the lowest of those is picked instead, so no port waits indefinitely.
+module boa_arbiter_aging#(
+    // Number of ports, at least 2.
+    parameter  ports    = 2,
+    // Number of cycles a port waits before it takes priority.
+    parameter  max_age  = 16,
+    // Number of bits in an age counter.
+    localparam age_bits = $clog2(max_age + 1)
+)(
+    // Latch the current arbiter value.
+    input  logic            clk,
+    // Synchronous reset.
+    input  logic            rst,
+    
+    // Requests.
+    input  logic[ports-1:0] req,
+    // Current arbitration result.
+    input  logic[ports-1:0] cur,
+    // Next arbitration result.
+    output logic[ports-1:0] next
+);
+    genvar x;
+    
+    // Number of cycles each port has been waiting.
+    logic[age_bits-1:0] age[ports];
+    // Ports that have been waiting for max_age cycles.
+    logic[ports-1:0]    aged;
+    // Ports considered for static prioritization.
+    logic[ports-1:0]    pool;
     
     always @(posedge clk) begin
-        if (rst) begin
-            hold <= 0;
-        end else begin
-            hold <= req != 0;
+        integer i;
+        for (i = 0; i < ports; i = i + 1) begin
+            if (rst || !req[i] || cur[i]) begin
+                age[i] <= 0;
+            end else if (age[i] != max_age) begin
+                age[i] <= age[i] + 1;
+            end
         end
     end
     
     generate
-        assign next[0] = req == cur ? cur[0] : req[0];
+        for (x = 0; x < ports; x = x + 1) begin
+            assign aged[x] = req[x] && age[x] == max_age;
+        end
+        assign pool    = aged != 0 ? aged : req;
+        assign next[0] = pool[0];
         for (x = 1; x < ports; x = x + 1) begin
-            assign next[x] = hold ? cur[x] : req[x] && req[x-1:0] == 0;
+            assign next[x] = pool[x] && pool[x-1:0] == 0;
         end
     endgenerate
 endmodule
 
 // Standard Boa memory demultiplexer.
+// Every time the memory accepts an access, the arbiter picks the CPU that presents the next one;
+// the other CPUs see ready low and hold their access. A burst is never interrupted, unless its CPU stops presenting it.
+// If pipelined, the CPU for the next address phase is picked one cycle in advance from the requests of the current cycle,
+// so a waiting CPU is presented while the current access finishes, and the arbiter is not in the path from the CPUs to the memory.
+// This costs a cycle when switching to a CPU that was idle.
+// Bandwidth caps limit the number of accesses a CPU gets per window of cycles while another CPU is waiting.
 module boa_mem_demux#(
     // Address bus size, at least 8.
-    parameter  alen     = 32,
+    parameter  alen         = 32,
     // Data bus size, 32 or 64.
-    parameter  dlen     = 32,
+    parameter  dlen         = 32,
     // Number of CPU ports, at least 2.
-    parameter  cpus     = 2,
+    parameter  cpus         = 2,
     // Arbitration method.
-    parameter  arbiter  = `BOA_ARBITER_RR,
+    parameter  arbiter      = `BOA_ARBITER_RR,
+    // Pick the CPU for the next address phase one cycle in advance.
+    parameter  pipelined    = 0,
+    // Length of the bandwidth cap window in cycles, 0 to disable bandwidth caps.
+    parameter  bw_window    = 0,
     // Number of write enables.
-    localparam wes      = dlen/8
+    localparam wes          = dlen/8,
+    // Number of bits in the bandwidth cap window counter.
+    localparam bw_bits      = $clog2(bw_window + 1)
 )(
     // CPU clock.
     input  logic    clk,
@@ -457,52 +656,137 @@ module boa_mem_demux#(
     // CPU ports.
     boa_mem_bus.MEM cpu[cpus],
     // MEM port.
-    boa_mem_bus.CPU mem
+    boa_mem_bus.CPU mem,
+    
+    // Maximum number of accesses per bandwidth cap window for each CPU port, 0 for no limit.
+    input  logic[7:0]       bw_cap[cpus]
 );
     genvar x;
     
     // Access requests.
     logic[cpus-1:0] req;
-    // Current arbitration result.
-    logic[cpus-1:0] cur = 1;
+    // CPU ports that used up their bandwidth cap in this window.
+    logic[cpus-1:0] capped;
+    // Access requests that may be granted; capped CPUs are only served if no other CPU is waiting.
+    logic[cpus-1:0] elig;
+    // CPU whose access the memory is handling.
+    logic[cpus-1:0] cur;
+    // CPU that was presented to the memory last, used as the current arbitration result.
+    logic[cpus-1:0] last;
     // Next arbitration result.
     logic[cpus-1:0] next;
-    // CPU that has custody next cycle.
-    logic[cpus-1:0] next_cpu;
+    // CPU that is presented to the memory.
+    logic[cpus-1:0] sel;
+    // A burst is in progress; custody stays with the current CPU until its last beat.
+    logic           lock;
+    // The memory accepts the access presented.
+    wire            accept      = mem.ready && (mem.re || mem.we != 0);
+    // A burst is in progress after this cycle; it is abandoned if its CPU stops presenting accesses.
+    wire            lock_next   = accept ? mem.blen != 0 && !mem.blast : lock && (mem.re || mem.we != 0);
     
     // Arbitration.
-    assign next_cpu = (cur & req) ? cur : next;
+    assign elig = (req & ~capped) != 0 ? req & ~capped : req;
     generate
         for (x = 0; x < cpus; x = x + 1) begin
-            assign req[x] = cpu[x].re || cpu[x].we;
+            assign req[x] = cpu[x].re || cpu[x].we != 0;
         end
         if (arbiter == `BOA_ARBITER_RR) begin: arbiter_rr
-            boa_arbiter_rr#(cpus) arbiter(clk, rst, req, cur, next);
+            boa_arbiter_rr#(cpus) arbiter(clk, rst, elig, last, next);
         end else if (arbiter == `BOA_ARBITER_STATIC) begin: arbiter_static
-            boa_arbiter_static#(cpus) arbiter(clk, rst, req, cur, next);
+            boa_arbiter_static#(cpus) arbiter(clk, rst, elig, last, next);
+        end else if (arbiter == `BOA_ARBITER_AGING) begin: arbiter_aging
+            boa_arbiter_aging#(cpus) arbiter(clk, rst, elig, last, next);
+        end
+        
+        if (pipelined) begin: pipe
+            // Latch the CPU for the next address phase.
+            always @(posedge clk) begin
+                if (rst) begin
+                    sel <= 1;
+                end else if (!lock_next && next != 0) begin
+                    sel <= next;
+                end
+            end
+            assign last = sel;
+        end else begin: comb
+            // Switch CPUs only when the memory can accept an access.
+            assign sel  = lock || !mem.ready ? cur : next;
+            assign last = cur;
         end
     endgenerate
     
-    // Latch arbitration result.
+    // Latch the CPU whose access was accepted.
     always @(posedge clk) begin
         if (rst) begin
             cur <= 1;
-        end else if (next_cpu != 0) begin
-            cur <= next_cpu;
+        end else if (accept) begin
+            cur <= sel;
+        end
+    end
+    
+    // Track bursts.
+    always @(posedge clk) begin
+        if (rst) begin
+            lock <= 0;
+        end else begin
+            lock <= lock_next;
         end
     end
     
+    // Bandwidth caps.
+    generate
+        if (bw_window != 0) begin: bw
+            // Cycles left in the current window.
+            logic[bw_bits-1:0]  left;
+            // Number of accesses each CPU got in the current window.
+            logic[7:0]          used[cpus];
+            always @(posedge clk) begin
+                integer i;
+                if (rst) begin
+                    left <= bw_window - 1;
+                    for (i = 0; i < cpus; i = i + 1) begin
+                        used[i] <= 0;
+                    end
+                end else if (left == 0) begin
+                    // Start a new window.
+                    left <= bw_window - 1;
+                    for (i = 0; i < cpus; i = i + 1) begin
+                        used[i] <= accept && sel[i];
+                    end
+                end else begin
+                    left <= left - 1;
+                    for (i = 0; i < cpus; i = i + 1) begin
+                        if (accept && sel[i] && used[i] != 255) begin
+                            used[i] <= used[i] + 1;
+                        end
+                    end
+                end
+            end
+            for (x = 0; x < cpus; x = x + 1) begin
+                assign capped[x] = bw_cap[x] != 0 && used[x] >= bw_cap[x];
+            end
+        end else begin: no_bw
+            assign capped = 0;
+        end
+    endgenerate
+    
     // Memory connection logic.
     logic           masked_re[cpus];
-    logic[3:0]      masked_we[cpus];
+    logic[wes-1:0]  masked_we[cpus];
     logic[alen-1:0] masked_addr[cpus];
     logic[dlen-1:0] masked_wdata[cpus];
+    logic[3:0]      masked_blen[cpus];
+    logic           masked_bwrap[cpus];
+    logic           masked_blast[cpus];
     generate
         for (x = 0; x < cpus; x = x + 1) begin
-            assign masked_re[x]     = next_cpu[x] ? cpu[x].re    : 0;
-            assign masked_we[x]     = next_cpu[x] ? cpu[x].we    : 0;
-            assign masked_addr[x]   = next_cpu[x] ? cpu[x].addr  : 0;
-            assign masked_wdata[x]  = next_cpu[x] ? cpu[x].wdata : 0;
+            assign masked_re[x]     = sel[x] ? cpu[x].re    : 0;
+            assign masked_we[x]     = sel[x] ? cpu[x].we    : 0;
+            assign masked_addr[x]   = sel[x] ? cpu[x].addr  : 0;
+            assign masked_wdata[x]  = sel[x] ? cpu[x].wdata : 0;
+            assign masked_blen[x]   = sel[x] ? cpu[x].blen  : 0;
+            assign masked_bwrap[x]  = sel[x] ? cpu[x].bwrap : 0;
+            assign masked_blast[x]  = sel[x] ? cpu[x].blast : 0;
         end
     endgenerate
     always @(*) begin
@@ -511,11 +795,17 @@ module boa_mem_demux#(
         mem.we      = 0;
         mem.addr    = 0;
         mem.wdata   = 0;
+        mem.blen    = 0;
+        mem.bwrap   = 0;
+        mem.blast   = 0;
         for (i = 0; i < cpus; i = i + 1) begin
             mem.re    |= masked_re[i];
             mem.we    |= masked_we[i];
             mem.addr  |= masked_addr[i];
             mem.wdata |= masked_wdata[i];
+            mem.blen  |= masked_blen[i];
+            mem.bwrap |= masked_bwrap[i];
+            mem.blast |= masked_blast[i];
         end
     end
     generate
@@ -530,19 +820,23 @@ endmodule
 // Standard Boa memory crossbar.
 module boa_mem_xbar#(
     // Address bus size, at least 8.
-    parameter  alen     = 32,
+    parameter  alen         = 32,
     // Data bus size, 32 or 64.
-    parameter  dlen     = 32,
+    parameter  dlen         = 32,
     // Number of CPU ports, at least 2.
-    parameter  cpus     = 2,
+    parameter  cpus         = 2,
     // Number of MEM ports, at least 2.
-    parameter  mems     = 2,
+    parameter  mems         = 2,
     // Arbitration method.
-    parameter  arbiter  = `BOA_ARBITER_RR,
+    parameter  arbiter      = `BOA_ARBITER_RR,
+    // Pick the CPU for the next address phase one cycle in advance.
+    parameter  pipelined    = 0,
+    // Length of the bandwidth cap window in cycles, 0 to disable bandwidth caps.
+    parameter  bw_window    = 0,
     // Number of write enables.
-    localparam wes      = dlen/8,
+    localparam wes          = dlen/8,
     // Number of bits in the exponent.
-    localparam elen     = $clog2(alen)
+    localparam elen         = $clog2(alen)
 )(
     // CPU clock.
     input  logic    clk,
@@ -557,11 +851,13 @@ module boa_mem_xbar#(
     // MEM port addresses, naturally aligned.
     input  logic[alen-1:0]  addr[mems],
     // MEM port size in log2(size_bytes).
-    input  logic[elen-1:0]  size[mems]
+    input  logic[elen-1:0]  size[mems],
+    // Maximum number of accesses per bandwidth cap window for each CPU port, 0 for no limit.
+    input  logic[7:0]       bw_cap[cpus]
 );
     genvar x, y;
     
-    boa_mem_bus#(alen) grid[cpus*mems]();
+    boa_mem_bus#(alen, dlen) grid[cpus*mems]();
     
     generate
         // CPU to grid connection.
@@ -575,7 +871,7 @@ module boa_mem_xbar#(
         // Grid to memory connection.
         for (x = 0; x < mems; x = x + 1) begin
             boa_mem_bus#(alen, dlen) row[cpus]();
-            boa_mem_demux#(alen, dlen, cpus, arbiter) demux(clk, rst, row, mem[x]);
+            boa_mem_demux#(alen, dlen, cpus, arbiter, pipelined, bw_window) demux(clk, rst, row, mem[x], bw_cap);
             for (y = 0; y < cpus; y = y + 1) begin
                 boa_mem_connector conn(grid[x*cpus+y], row[y]);
             end
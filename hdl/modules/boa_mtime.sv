@@ -10,17 +10,19 @@ module boa_mtime#(
     parameter addr = 32'hffff_f000
 )(
     // CPU clock.
-    input  logic    clk,
+    input  logic        clk,
     // Timekeeping clock.
-    input  logic    rtc_clk,
+    input  logic        rtc_clk,
     // Synchronous reset.
-    input  logic    rst,
+    input  logic        rst,
     
     // Memory bus.
-    boa_mem_bus.MEM bus,
+    boa_mem_bus.MEM     bus,
     
     // Interrupt signal.
-    output logic    irq
+    output logic        irq,
+    // Current time in the CPU domain, for the time CSR.
+    output logic[63:0]  cur_time
 );
     initial begin
         bus.ready = 1;
@@ -61,6 +63,7 @@ module boa_mtime#(
     
     // Domain crossing logic.
     always @(posedge clk) cpu_mtime <= rtc_mtime;
+    assign cur_time = cpu_mtime;
     always @(posedge clk) cpu_mtime_ack <= rtc_mtime_ack;
     always @(posedge rtc_clk) rtc_mtimecmp <= cpu_mtimecmp;
     always @(posedge rtc_clk) rtc_mtime_we <= cpu_mtime_we;
@@ -59,8 +59,8 @@ module boa_pmp#(
     // Access checking ports.
     boa_pmp_bus.PMP     check_ports[checkers],
     
-    // One of the PMPs is being locked.
-    output logic        locking
+    // A pmpcfg or pmpaddr CSR is being written, so permissions may change.
+    output logic        changing
 );
     // PMP lock bits.
     reg                 pmplock[depth];
@@ -79,16 +79,8 @@ module boa_pmp#(
         writeable[depth-1] = !pmplock[depth-1];
     end
     
-    // Locking detection.
-    always @(*) begin
-        locking = 0;
-        if (csr.we && csr.addr >= `RV_CSR_PMPCFG0 && csr.addr < `RV_CSR_PMPCFG0 + (depth + 3) / 4) begin
-            if (writeable[4 * csr.addr[3:0]] && csr.wdata[7])   locking = 1;
-            if (writeable[4 * csr.addr[3:0]+1] && csr.wdata[15]) locking = 1;
-            if (writeable[4 * csr.addr[3:0]+2] && csr.wdata[23]) locking = 1;
-            if (writeable[4 * csr.addr[3:0]+3] && csr.wdata[31]) locking = 1;
-        end
-    end
+    // Change detection; permissions checked before any write may be stale, not just those of M-mode after locking.
+    assign changing = csr.we && csr.exists;
     
     // CSR read interface.
     always @(*) begin
@@ -14,11 +14,28 @@ module boa_stage_ex#(
     // Divider pipeline register distribution.
     // Only applicable if has_m is 1.
     parameter div_distr     = "center",
+    // Use an iterative divider with early termination instead; div_latency and div_distr are ignored.
+    // Only applicable if has_m is 1.
+    parameter div_iterative = 0,
+    // Iterative divider radix, 2 or 4.
+    // Only applicable if div_iterative is 1.
+    parameter div_radix     = 4,
     // Multiplier latency, 0 or 1.
     // Only applicable if has_m is 1.
     parameter mul_latency   = 0,
+    // Cache the last division result to fuse DIV and REM with the same operands.
+    // Only applicable if has_m is 1 and div_latency or div_iterative is not 0.
+    parameter div_fusion    = 1,
     // Support M (multiply/divide) instructions.
-    parameter has_m         = 1
+    parameter has_m         = 1,
+    // Support cache-block prefetch hints (Zicbop).
+    parameter has_zicbop    = 0,
+    // Support address generation instructions (Zba).
+    parameter has_zba       = 0,
+    // Support basic bit-manipulation instructions (Zbb).
+    parameter has_zbb       = 0,
+    // Support single-bit instructions (Zbs).
+    parameter has_zbs       = 0
 )(
     // CPU clock.
     input  logic        clk,
@@ -74,6 +91,10 @@ module boa_stage_ex#(
     
     // EX/IF: Mispredicted branch.
     output logic        fw_branch_correct,
+    // EX/ID: Conditional branch resolved.
+    output logic        fw_branch_resolve,
+    // EX/ID: Resolved conditional branch was taken.
+    output logic        fw_branch_taken,
     // Stall EX stage.
     input  logic        fw_stall_ex,
     // Produces final result.
@@ -164,11 +185,17 @@ module boa_stage_ex#(
     wire        div_u     = r_insn[12];
     wire        shr_arith = r_insn[30];
     wire        shr       = r_insn[14];
-    wire        muldiv_en = r_insn[25] && r_insn[5];
+    wire        muldiv_en = r_insn[31:25] == 7'b0000001 && r_insn[5];
     logic[63:0] mul_res;
     logic[31:0] div_res;
     logic[31:0] mod_res;
     logic[31:0] shx_res;
+    // Division in EX is served from the result cache.
+    logic       div_fused;
+    // Division in EX needs the divider.
+    wire        div_req   = r_valid && r_insn[6:2] == `RV_OP_OP && muldiv_en && r_insn[14] && !div_fused;
+    // Iterative divider result valid.
+    logic       div_valid;
     generate
         if (has_m && mul_latency == 0) begin
             boa_mul_simple mul(mul_u_lhs, mul_u_rhs, r_rs1_val, r_rs2_val, mul_res);
@@ -189,27 +216,102 @@ module boa_stage_ex#(
         end else begin: nomul
             assign mul_res = 'bx;
         end
-        if (has_m && div_latency == 0) begin: l0div
+        if (has_m && div_iterative) begin: itdiv
+            boa_div_iterative#(.radix(div_radix)) div(
+                clk, rst, div_req, !fw_stall_ex, div_u, r_rs1_val, r_rs2_val, div_valid, div_res, mod_res
+            );
+        end else if (has_m && div_latency == 0) begin: l0div
             boa_div_simple div(
                 div_u, r_rs1_val, r_rs2_val, div_res, mod_res
             );
+            assign div_valid = 1;
         end else if (has_m) begin: l1div
             boa_div_pipelined#(.latency(div_latency), .distribution(div_distr)) div(
                 clk, div_u, r_rs1_val, r_rs2_val, div_res, mod_res
             );
+            assign div_valid = 1;
         end else begin: nodiv
-            assign div_res = 'bx;
-            assign mod_res = 'bx;
+            assign div_res   = 'bx;
+            assign mod_res   = 'bx;
+            assign div_valid = 1;
         end
     endgenerate
     boa_shift_simple shift(shr_arith, shr, r_rs1_val, op_rhs_mux, shx_res);
     
+    // Bit-manipulation unit.
+    logic       bm_en;
+    logic[31:0] bm_res;
+    boa_stage_ex_bitmanip#(.has_zba(has_zba), .has_zbb(has_zbb), .has_zbs(has_zbs)) bitmanip(
+        r_insn, r_rs1_val, op_rhs_mux, bm_en, bm_res
+    );
+    
     // Computation delay module.
-    logic div_stall_req, mul_stall_req;
+    logic div_stall_req, div_delay_req, mul_stall_req;
     assign stall_req = div_stall_req || mul_stall_req;
-    wire is_divmod = has_m && d_valid && d_insn[6:2] == `RV_OP_OP && d_insn[25] && d_insn[14];
-    boa_delay_comp#(div_latency) div_delay(clk, is_divmod, div_stall_req);
-    wire is_mul    = has_m && d_valid && d_insn[6:2] == `RV_OP_OP && d_insn[25] && !d_insn[14];
+    wire is_divmod = has_m && d_valid && d_insn[6:2] == `RV_OP_OP && d_insn[31:25] == 7'b0000001 && d_insn[14];
+    logic div_fuse;
+    boa_delay_comp#(div_iterative ? 0 : div_latency) div_delay(clk, is_divmod && !div_fuse, div_delay_req);
+    assign div_stall_req = div_iterative ? has_m && div_req && !div_valid : div_delay_req;
+    
+    // Division result cache.
+    logic[31:0] div_out;
+    logic[31:0] mod_out;
+    generate
+        if (has_m && (div_latency || div_iterative) && div_fusion) begin: fuse
+            // Cache entry valid.
+            logic       c_valid;
+            // Cached division was unsigned.
+            logic       c_u;
+            // Cached left-hand side.
+            logic[31:0] c_lhs;
+            // Cached right-hand side.
+            logic[31:0] c_rhs;
+            // Cached division result.
+            logic[31:0] c_div;
+            // Cached modulo result.
+            logic[31:0] c_mod;
+            // Division in EX is served from the cache.
+            logic       r_fused;
+            
+            // A division or modulo completes in EX.
+            wire div_done = r_valid && r_insn[6:2] == `RV_OP_OP && muldiv_en && r_insn[14] && !stall_req && !fw_stall_ex;
+            
+            // The incoming division has the same operands as the cached or completing one.
+            assign div_fuse = is_divmod && (
+                (c_valid  && c_u   == d_insn[12] && c_lhs     == d_rs1_val && c_rhs     == d_rs2_val) ||
+                (div_done && div_u == d_insn[12] && r_rs1_val == d_rs1_val && r_rs2_val == d_rs2_val)
+            );
+            
+            // Cache logic.
+            assign div_fused = r_fused;
+            assign div_out   = r_fused ? c_div : div_res;
+            assign mod_out   = r_fused ? c_mod : mod_res;
+            always @(posedge clk) begin
+                if (rst) begin
+                    c_valid <= 0;
+                    r_fused <= 0;
+                end else begin
+                    if (div_done) begin
+                        c_valid <= 1;
+                        c_u     <= div_u;
+                        c_lhs   <= r_rs1_val;
+                        c_rhs   <= r_rs2_val;
+                        c_div   <= div_out;
+                        c_mod   <= mod_out;
+                    end
+                    if (!fw_stall_ex) begin
+                        r_fused <= div_fuse;
+                    end
+                end
+            end
+        end else begin: nofuse
+            assign div_fuse  = 0;
+            assign div_fused = 0;
+            assign div_out   = div_res;
+            assign mod_out   = mod_res;
+        end
+    endgenerate
+    wire is_mul    = has_m && d_valid && d_insn[6:2] == `RV_OP_OP && d_insn[31:25] == 7'b0000001 && !d_insn[14];
     boa_delay_comp#(mul_latency) mul_delay(clk, is_mul, mul_stall_req);
     
     // Adder mode.
@@ -217,11 +319,18 @@ module boa_stage_ex#(
     wire        xorh          = cmp && (r_insn[4] ? !r_insn[12] : !r_insn[13]);
     wire        sub           = cmp || ((r_insn[6:2] == `RV_OP_OP) && r_insn[30]);
     
+    // PREFETCH hints are ORI with RD=0; the low 5 bits of the immediate select the kind of prefetch.
+    wire        is_prefetch   = has_zicbop && (r_insn[6:2] == `RV_OP_OP_IMM) && (r_insn[14:12] == `RV_ALU_OR) && (r_insn[11:7] == 0);
+    
     // Adder operands.
     logic[31:0] add_lhs_mux;
     logic[31:0] add_rhs_mux;
     always @(*) begin
-        if (r_insn[6:2] == `RV_OP_LOAD) begin
+        if (is_prefetch) begin
+            // PREFETCH hints.
+            add_lhs_mux         = r_rs1_val;
+            add_rhs_mux         = {imm12_i[31:5], 5'b00000};
+        end else if (r_insn[6:2] == `RV_OP_LOAD) begin
             // LOAD instructions.
             add_lhs_mux         = r_rs1_val;
             add_rhs_mux         = imm12_i;
@@ -257,18 +366,23 @@ module boa_stage_ex#(
     // Branch condition evaluation.
     wire   branch_cond       = r_insn[12] ^ (r_insn[14] ? cmp_lt : cmp_eq);
     assign fw_branch_correct = r_valid && (r_insn[6:2] == `RV_OP_BRANCH) && (branch_cond != r_branch_predict);
+    assign fw_branch_resolve = r_valid && (r_insn[6:2] == `RV_OP_BRANCH) && !clear && !fw_stall_ex;
+    assign fw_branch_taken   = branch_cond;
     
     // Output LHS multiplexer.
     logic[31:0] out_mux;
     always @(*) begin
         if (is_op) begin
-            if (has_m && muldiv_en) begin
+            if (bm_en) begin
+                // Bit-manipulation instructions.
+                out_mux = bm_res;
+            end else if (has_m && muldiv_en) begin
                 // MULDIV instructions.
                 casez (r_insn[14:12])
                     3'b000:  out_mux = mul_res[31:0];
                     default: out_mux = mul_res[63:32];
-                    3'b10?:  out_mux = div_res;
-                    3'b11?:  out_mux = mod_res;
+                    3'b10?:  out_mux = div_out;
+                    3'b11?:  out_mux = mod_out;
                 endcase
             end else begin
                 // OP and OP-IMM instructions.
@@ -279,7 +393,7 @@ module boa_stage_ex#(
                     `RV_ALU_SLTU: out_mux = cmp_lt;
                     `RV_ALU_XOR:  out_mux = r_rs1_val ^ op_rhs_mux;
                     `RV_ALU_SRL:  out_mux = shx_res;
-                    `RV_ALU_OR:   out_mux = r_rs1_val | op_rhs_mux;
+                    `RV_ALU_OR:   out_mux = is_prefetch ? add_res : r_rs1_val | op_rhs_mux;
                     `RV_ALU_AND:  out_mux = r_rs1_val & op_rhs_mux;
                 endcase
             end
@@ -349,6 +463,10 @@ module boa_stage_ex_fw(
             // LOAD and STORE instructions.
             use_rs1 = 1;
             use_rs2 = 0;
+        end else if ((d_insn[6:2] == `RV_OP_MISC_MEM) && (d_insn[14:12] == 2)) begin
+            // CBO instructions; EX passes RS1 on as the address.
+            use_rs1 = 1;
+            use_rs2 = 0;
         end else begin
             // Other instructions.
             use_rs1 = 0;
@@ -356,3 +474,111 @@ module boa_stage_ex_fw(
         end
     end
 endmodule
+
+
+
+// Bit-manipulation unit for the RV32 forms of the Zba, Zbb and Zbs instructions in OP and OP-IMM.
+module boa_stage_ex_bitmanip#(
+    // Support address generation instructions (Zba).
+    parameter has_zba       = 0,
+    // Support basic bit-manipulation instructions (Zbb).
+    parameter has_zbb       = 0,
+    // Support single-bit instructions (Zbs).
+    parameter has_zbs       = 0
+)(
+    // Current instruction word.
+    input  logic[31:0]  insn,
+    // Value from RS1 register.
+    input  logic[31:0]  lhs,
+    // Value from RS2 register or immediate.
+    input  logic[31:0]  rhs,
+    
+    // Is a supported bit-manipulation instruction.
+    output logic        en,
+    // Result.
+    output logic[31:0]  res
+);
+    // Single-bit mask selected by RHS.
+    wire [31:0] bit_mask    = 32'h0000_0001 << rhs[4:0];
+    // LHS rotated left by RHS.
+    wire [63:0] rol_tmp     = {lhs, lhs} << rhs[4:0];
+    // LHS rotated right by RHS.
+    wire [63:0] ror_tmp     = {lhs, lhs} >> rhs[4:0];
+    
+    // Unary operations: CLZ, CTZ and CPOP.
+    logic[5:0]  clz_res;
+    logic[5:0]  ctz_res;
+    logic[5:0]  cpop_res;
+    always @(*) begin
+        integer i;
+        clz_res  = 32;
+        ctz_res  = 32;
+        cpop_res = 0;
+        for (i = 0; i < 32; i = i + 1) begin
+            if (lhs[i]) begin
+                clz_res  = 31 - i;
+            end
+            if (lhs[31-i]) begin
+                ctz_res  = 31 - i;
+            end
+            cpop_res += lhs[i];
+        end
+    end
+    
+    // Byte-wise operations: ORC.B and REV8.
+    logic[31:0] orc_res;
+    logic[31:0] rev_res;
+    always @(*) begin
+        integer i;
+        for (i = 0; i < 4; i = i + 1) begin
+            orc_res[i*8 +: 8]     = lhs[i*8 +: 8] != 0 ? 8'hff : 8'h00;
+            rev_res[i*8 +: 8]     = lhs[(3-i)*8 +: 8];
+        end
+    end
+    
+    // Operation decoder.
+    always @(*) begin
+        en  = 0;
+        res = 'bx;
+        if (insn[6:2] == `RV_OP_OP) begin
+            // OP instructions.
+            casez ({insn[31:25], insn[14:12]})
+                default:         begin end
+                10'b0010000_010: begin en = has_zba; res = (lhs << 1) + rhs; end // SH1ADD
+                10'b0010000_100: begin en = has_zba; res = (lhs << 2) + rhs; end // SH2ADD
+                10'b0010000_110: begin en = has_zba; res = (lhs << 3) + rhs; end // SH3ADD
+                10'b0100000_100: begin en = has_zbb; res = ~(lhs ^ rhs); end     // XNOR
+                10'b0100000_110: begin en = has_zbb; res = lhs | ~rhs; end       // ORN
+                10'b0100000_111: begin en = has_zbb; res = lhs & ~rhs; end       // ANDN
+                10'b0000101_100: begin en = has_zbb; res = $signed(lhs) < $signed(rhs) ? lhs : rhs; end // MIN
+                10'b0000101_101: begin en = has_zbb; res = lhs < rhs ? lhs : rhs; end                   // MINU
+                10'b0000101_110: begin en = has_zbb; res = $signed(lhs) < $signed(rhs) ? rhs : lhs; end // MAX
+                10'b0000101_111: begin en = has_zbb; res = lhs < rhs ? rhs : lhs; end                   // MAXU
+                10'b0110000_001: begin en = has_zbb; res = rol_tmp[63:32]; end   // ROL
+                10'b0110000_101: begin en = has_zbb; res = ror_tmp[31:0]; end    // ROR
+                10'b0000100_100: begin en = has_zbb; res = {16'h0000, lhs[15:0]}; end // ZEXT.H
+                10'b0100100_001: begin en = has_zbs; res = lhs & ~bit_mask; end  // BCLR
+                10'b0100100_101: begin en = has_zbs; res = (lhs & bit_mask) != 0; end // BEXT
+                10'b0010100_001: begin en = has_zbs; res = lhs | bit_mask; end   // BSET
+                10'b0110100_001: begin en = has_zbs; res = lhs ^ bit_mask; end   // BINV
+            endcase
+        end else if (insn[6:2] == `RV_OP_OP_IMM) begin
+            // OP-IMM instructions.
+            casez ({insn[31:20], insn[14:12]})
+                default:                begin end
+                15'b0110000_00000_001:  begin en = has_zbb; res = clz_res; end   // CLZ
+                15'b0110000_00001_001:  begin en = has_zbb; res = ctz_res; end   // CTZ
+                15'b0110000_00010_001:  begin en = has_zbb; res = cpop_res; end  // CPOP
+                15'b0110000_00100_001:  begin en = has_zbb; res = {{24{lhs[7]}}, lhs[7:0]}; end   // SEXT.B
+                15'b0110000_00101_001:  begin en = has_zbb; res = {{16{lhs[15]}}, lhs[15:0]}; end // SEXT.H
+                15'b0110000_?????_101:  begin en = has_zbb; res = ror_tmp[31:0]; end // RORI
+                15'b0010100_00111_101:  begin en = has_zbb; res = orc_res; end   // ORC.B
+                15'b0110100_11000_101:  begin en = has_zbb; res = rev_res; end   // REV8
+                15'b0100100_?????_001:  begin en = has_zbs; res = lhs & ~bit_mask; end // BCLRI
+                15'b0100100_?????_101:  begin en = has_zbs; res = (lhs & bit_mask) != 0; end // BEXTI
+                15'b0010100_?????_001:  begin en = has_zbs; res = lhs | bit_mask; end  // BSETI
+                15'b0110100_?????_001:  begin en = has_zbs; res = lhs ^ bit_mask; end  // BINVI
+            endcase
+        end
+    end
+endmodule
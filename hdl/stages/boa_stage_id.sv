@@ -15,7 +15,20 @@ module boa_stage_id#(
     // Support A (atomic memory operation) instructions.
     parameter has_a         = 1,
     // Support C (compressed) instructions.
-    parameter has_c         = 1
+    parameter has_c         = 1,
+    // Support cache-block management instructions (Zicbom).
+    parameter has_zicbom    = 0,
+    // Support address generation instructions (Zba).
+    parameter has_zba       = 0,
+    // Support basic bit-manipulation instructions (Zbb).
+    parameter has_zbb       = 0,
+    // Support single-bit instructions (Zbs).
+    parameter has_zbs       = 0,
+    // Number of branch history table entries, 0 for static prediction.
+    parameter bht_depth     = 0,
+    // Number of global history bits hashed into the branch history table index.
+    // Only applicable if bht_depth is not 0.
+    parameter bht_history   = 0
 )(
     // CPU clock.
     input  logic        clk,
@@ -33,6 +46,8 @@ module boa_stage_id#(
     input  logic[31:1]  d_pc,
     // IF/ID: Current instruction word.
     input  logic[31:0]  d_insn,
+    // IF/ID: Predicted address of the next instruction.
+    input  logic[31:1]  d_pred_pc,
     // IF/ID: Trap raised.
     input  logic        d_trap,
     // IF/ID: Trap cause.
@@ -79,6 +94,16 @@ module boa_stage_id#(
     output logic        branch_predict,
     // Branch target address.
     output logic[31:1]  branch_target,
+    // Address IF predicted to follow this instruction.
+    output logic[31:1]  pred_pc,
+    // Jump that pushes a return address (function call).
+    output logic        is_call,
+    // Jump that pops a return address (function return).
+    output logic        is_ret,
+    // Conditional branch resolved in EX.
+    input  logic        fw_branch_resolve,
+    // Resolved conditional branch was taken.
+    input  logic        fw_branch_taken,
     
     // Write-back enable.
     input  logic        wb_we,
@@ -103,6 +128,8 @@ module boa_stage_id#(
     logic[31:1] r_pc;
     // IF/ID: Current instruction word.
     logic[31:0] r_insn;
+    // IF/ID: Predicted address of the next instruction.
+    logic[31:1] r_pred_pc;
     // IF/ID: Trap raised.
     logic       r_trap;
     // IF/ID: Trap cause.
@@ -111,17 +138,19 @@ module boa_stage_id#(
     // Pipline barrier register.
     always @(posedge clk) begin
         if (rst) begin
-            r_valid <= 0;
-            r_pc    <= 'bx;
-            r_insn  <= 'bx;
-            r_trap  <= 0;
-            r_cause <= 'bx;
+            r_valid   <= 0;
+            r_pc      <= 'bx;
+            r_insn    <= 'bx;
+            r_pred_pc <= 'bx;
+            r_trap    <= 0;
+            r_cause   <= 'bx;
         end else if (!fw_stall_id) begin
-            r_valid <= d_valid;
-            r_pc    <= d_pc;
-            r_insn  <= d_insn;
-            r_trap  <= d_trap;
-            r_cause <= d_cause;
+            r_valid   <= d_valid;
+            r_pc      <= d_pc;
+            r_insn    <= d_insn;
+            r_pred_pc <= d_pred_pc;
+            r_trap    <= d_trap;
+            r_cause   <= d_cause;
         end
     end
     
@@ -146,7 +175,7 @@ module boa_stage_id#(
     // Instruction validator.
     wire insn_valid, insn_legal;
     boa_insn_validator#(
-        .has_m(has_m), .has_a(has_a)
+        .has_m(has_m), .has_a(has_a), .has_zicbom(has_zicbom), .has_zba(has_zba), .has_zbb(has_zbb), .has_zbs(has_zbs)
     ) validator(
         r_insn, cur_priv, 0, cur_misa,
         insn_valid, insn_legal
@@ -176,10 +205,30 @@ module boa_stage_id#(
     // Branch decoding logic.
     logic is_xret_tmp;
     boa_branch_decoder branch_decd(insn, r_pc, fw_rs1_bt ? fw_val : rs1_val, is_xret_tmp, is_branch, is_jump, branch_target, use_rs1_bt);
-    assign branch_predict = insn[31];
     assign is_sret        = !insn[29];
+    assign pred_pc        = r_pred_pc;
+    
+    // Return address stack hints; x1 and x5 are link registers.
+    wire   rd_link        = insn[11:7] == 1 || insn[11:7] == 5;
+    wire   rs1_link       = insn[19:15] == 1 || insn[19:15] == 5;
+    assign is_call        = is_jump && rd_link;
+    assign is_ret         = is_jump && insn[6:2] == `RV_OP_JALR && rs1_link && (!rd_link || insn[11:7] != insn[19:15]);
     assign is_xret        = is_xret_tmp && insn_valid && insn_legal;
     
+    // Branch prediction logic.
+    generate
+        if (bht_depth) begin: dyn_bp
+            boa_bht#(.depth(bht_depth), .history(bht_history)) bht(
+                clk, rst,
+                r_pc, !fw_stall_id, branch_predict,
+                fw_branch_resolve, fw_branch_taken
+            );
+        end else begin: static_bp
+            // Predict backward branches taken.
+            assign branch_predict = insn[31];
+        end
+    endgenerate
+    
     // Pipeline output logic.
     assign q_pc             = r_pc;
     assign q_insn           = insn;
@@ -357,6 +406,76 @@ endmodule
 
 
 
+// Branch history table: dynamic conditional branch prediction using 2-bit saturating counters.
+// Optionally XORs global branch history into the index (gshare).
+module boa_bht#(
+    // Number of counters, a power of 2 of at least 2.
+    parameter  depth    = 64,
+    // Number of global history bits, 0 to index by PC only.
+    parameter  history  = 0,
+    // Number of index bits.
+    localparam abits    = $clog2(depth),
+    // Global history mask.
+    localparam hmask    = (1 << (history > abits ? abits : history)) - 1
+)(
+    // CPU clock.
+    input  logic        clk,
+    // Synchronous reset.
+    input  logic        rst,
+    
+    // Address of the branch to predict.
+    input  logic[31:1]  pc,
+    // The branch to predict advances to EX.
+    input  logic        next,
+    // Branch predicted taken.
+    output logic        predict,
+    
+    // The branch in EX was resolved.
+    input  logic        resolve,
+    // The branch in EX was taken.
+    input  logic        taken
+);
+    // Saturating counters; taken if the upper bit is set.
+    logic[1:0]          counters[depth];
+    // Global branch history.
+    logic[abits-1:0]    ghr;
+    // Index used for the branch in EX.
+    logic[abits-1:0]    r_index;
+    
+    // Start weakly not taken.
+    initial begin
+        integer i;
+        for (i = 0; i < depth; i = i + 1) begin
+            counters[i] = 2'b01;
+        end
+    end
+    
+    // Prediction logic.
+    wire [abits-1:0] index = pc[abits:1] ^ ghr;
+    assign predict = counters[index][1];
+    always @(posedge clk) begin
+        if (next) begin
+            r_index <= index;
+        end
+    end
+    
+    // Training logic.
+    always @(posedge clk) begin
+        if (rst) begin
+            ghr <= 0;
+        end else if (resolve) begin
+            ghr <= ((ghr << 1) | taken) & hmask;
+        end
+        if (resolve && taken && counters[r_index] != 2'b11) begin
+            counters[r_index] <= counters[r_index] + 1;
+        end else if (resolve && !taken && counters[r_index] != 2'b00) begin
+            counters[r_index] <= counters[r_index] - 1;
+        end
+    end
+endmodule
+
+
+
 // Determines the presence of registers in instructions.
 module boa_reg_decoder#(
     // Check for atomic instructions.
@@ -378,7 +497,7 @@ module boa_reg_decoder#(
             default:            begin end
             `RV_OP_LOAD:        begin has_rs1 = 1; has_rs2 = 0; has_rs3 = 0; has_rd = 1; end
             `RV_OP_LOAD_FP:     if (f) begin has_rs1 = 1; has_rs2 = 0; has_rs3 = 0; has_rd = 1; end
-            `RV_OP_MISC_MEM:    begin has_rs1 = 0; has_rs2 = 0; has_rs3 = 0; has_rd = 0; end
+            `RV_OP_MISC_MEM:    begin has_rs1 = insn[14:12] == 2; has_rs2 = 0; has_rs3 = 0; has_rd = 0; end
             `RV_OP_OP_IMM:      begin has_rs1 = 1; has_rs2 = 0; has_rs3 = 0; has_rd = 1; end
             `RV_OP_AUIPC:       begin has_rs1 = 0; has_rs2 = 0; has_rs3 = 0; has_rd = 1; end
             `RV_OP_OP_IMM_32:   if (rv64) begin has_rs1 = 1; has_rs2 = 0; has_rs3 = 0; has_rd = 1; end
@@ -423,7 +542,15 @@ module boa_insn_validator#(
     // Allow long double instructions.
     parameter has_q = 0,
     // Allow S-mode instructions.
-    parameter has_s_mode = 0
+    parameter has_s_mode = 0,
+    // Allow cache-block management instructions.
+    parameter has_zicbom = 0,
+    // Allow address generation instructions.
+    parameter has_zba = 0,
+    // Allow basic bit-manipulation instructions.
+    parameter has_zbb = 0,
+    // Allow single-bit instructions.
+    parameter has_zbs = 0
 )(
     // Instruction to verify.
     input  logic[31:0]  insn,
@@ -497,6 +624,39 @@ module boa_insn_validator#(
     end
     
     
+    // Bit-manipulation verifier for OP-IMM; only the RV32 forms are supported.
+    logic valid_zb_imm;
+    always @(*) begin
+        casez ({insn[31:20], insn[14:12]})
+            default:                    valid_zb_imm = 0;
+            15'b0110000_00???_001:      valid_zb_imm = has_zbb && insn[22:20] <= 2; // CLZ, CTZ and CPOP
+            15'b0110000_0010?_001:      valid_zb_imm = has_zbb;                     // SEXT.B and SEXT.H
+            15'b0110000_?????_101:      valid_zb_imm = has_zbb;                     // RORI
+            15'b0010100_00111_101:      valid_zb_imm = has_zbb;                     // ORC.B
+            15'b0110100_11000_101:      valid_zb_imm = has_zbb;                     // REV8
+            15'b0100100_?????_?01:      valid_zb_imm = has_zbs;                     // BCLRI and BEXTI
+            15'b0010100_?????_001:      valid_zb_imm = has_zbs;                     // BSETI
+            15'b0110100_?????_001:      valid_zb_imm = has_zbs;                     // BINVI
+        endcase
+    end
+    
+    // Bit-manipulation verifier for OP; only the RV32 forms are supported.
+    logic valid_zb_op;
+    always @(*) begin
+        casez ({insn[31:25], insn[14:12]})
+            default:            valid_zb_op = 0;
+            10'b0010000_??0:    valid_zb_op = has_zba && insn[14:12] != 0;  // SH1ADD, SH2ADD and SH3ADD
+            10'b0100000_1??:    valid_zb_op = has_zbb && insn[13:12] != 1;  // XNOR, ORN and ANDN
+            10'b0000101_1??:    valid_zb_op = has_zbb;                      // MIN, MINU, MAX and MAXU
+            10'b0110000_?01:    valid_zb_op = has_zbb;                      // ROL and ROR
+            10'b0000100_100:    valid_zb_op = has_zbb && insn[24:20] == 0;  // ZEXT.H
+            10'b0100100_?01:    valid_zb_op = has_zbs;                      // BCLR and BEXT
+            10'b0010100_001:    valid_zb_op = has_zbs;                      // BSET
+            10'b0110100_001:    valid_zb_op = has_zbs;                      // BINV
+        endcase
+    end
+    
+    
     // SYSTEM opcode verifier.
     logic valid_system;
     logic legal_system;
@@ -513,13 +673,18 @@ module boa_insn_validator#(
             endcase
             legal_system = privilege >= required;
         end else begin
-            // CSR instructions.
+            // CSR instructions; address bits 9:8 are the lowest privilege that may access the CSR.
             valid_system = insn[14:12] != 3'b100;
-            legal_system = 1;
+            legal_system = privilege >= insn[29:28];
         end
     end
     
     
+    // Cache-block management verifier.
+    // There is no menvcfg, so these are only legal in M-mode.
+    wire valid_cbo      = has_zicbom && insn[14:12] == 3'b010 && insn[11:7] == 0 && insn[31:20] <= 2;
+    
+    
     // AMO opcode verifier.
     logic valid_amo;
     always @(*) begin
@@ -548,14 +713,14 @@ module boa_insn_validator#(
             default:            begin valid = 0; end
             `RV_OP_LOAD:        begin valid = insn[14] ? (insn[13:12] < 2) + rv64 : (insn[13:12] < 3) + rv64; end
             `RV_OP_LOAD_FP:     begin valid = 0; $strobe("TODO: validity for LOAD_FP"); end
-            `RV_OP_MISC_MEM:    begin valid = insn[14:12] == 0 || insn[14:12] == 1; end
-            `RV_OP_OP_IMM:      begin valid = valid_op_imm; end
+            `RV_OP_MISC_MEM:    begin valid = insn[14:12] == 0 || insn[14:12] == 1 || valid_cbo; legal = insn[14:12] != 2 || privilege == 3; end
+            `RV_OP_OP_IMM:      begin valid = valid_op_imm || valid_zb_imm; end
             `RV_OP_AUIPC:       begin valid = 1; end
             `RV_OP_OP_IMM_32:   begin valid = rv64 && valid_op_imm; end
             `RV_OP_STORE:       begin valid = (insn[14] == 0) && (insn[13:12] <= 2) + rv64; end
             `RV_OP_STORE_FP:    begin valid = 0; $strobe("TODO: validity for STORE_FP"); end
             `RV_OP_AMO:         begin valid = allow_a && valid_amo; end
-            `RV_OP_OP:          begin valid = valid_op; end
+            `RV_OP_OP:          begin valid = valid_op || valid_zb_op; end
             `RV_OP_LUI:         begin valid = 1; end
             `RV_OP_OP_32:       begin valid = rv64 && valid_op; end
             `RV_OP_MADD:        begin valid = 0; $strobe("TODO: validity for MADD"); end
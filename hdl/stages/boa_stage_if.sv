@@ -20,8 +20,15 @@ module boa_stage_if#(
     parameter entrypoint    = 32'h4000_0000,
     // Depth of the instruction cache, at least 2.
     parameter cache_depth   = 4,
+    // Number of 4-byte words in the direct-mapped L0 instruction buffer, 0 to disable.
+    // Enables demand fetching with next-line prefetch instead of continuous sequential fetching.
+    parameter l0_depth      = 0,
     // Enable additional latch in IF branch address.
-    parameter if_branch_reg = 0
+    parameter if_branch_reg = 0,
+    // Number of branch target buffer entries, 0 to disable.
+    parameter btb_depth     = 0,
+    // Number of return address stack entries, 0 or a power of 2 of at least 2.
+    parameter ras_depth     = 0
 )(
     // CPU clock.
     input  logic        clk,
@@ -44,6 +51,8 @@ module boa_stage_if#(
     output logic[31:1]  q_pc,
     // IF/ID: Current instruction word.
     output logic[31:0]  q_insn,
+    // IF/ID: Predicted address of the next instruction.
+    output logic[31:1]  q_pred_pc,
     // IF/ID: Trap raised.
     output logic        q_trap,
     // IF/ID: Trap cause.
@@ -57,8 +66,18 @@ module boa_stage_if#(
     input  logic        fw_branch_predict,
     // Branch target address.
     input  logic[31:1]  fw_branch_target,
-    // Address of the next instruction.
-    output logic[31:1]  if_next_pc,
+    // Update the branch target buffer.
+    input  logic        fw_btb_we,
+    // Address of the control transfer to update.
+    input  logic[31:1]  fw_btb_pc,
+    // Control transfer is predicted taken; the entry is removed otherwise.
+    input  logic        fw_btb_taken,
+    // Instruction in ID pushes a return address.
+    input  logic        fw_ras_push,
+    // Instruction in ID pops a return address.
+    input  logic        fw_ras_pop,
+    // Return address pushed by the instruction in ID.
+    input  logic[31:1]  fw_ras_addr,
     // Branch to be corrected.
     input  logic        fw_branch_correct,
     // Branch correction address.
@@ -70,7 +89,7 @@ module boa_stage_if#(
     
     // Stall IF stage.
     input  logic        fw_stall_if,
-    // Clear cache.
+    // Clear cache and L0 buffer; execute permissions are about to change.
     input  logic        fw_cclear
 );
     genvar x;
@@ -91,8 +110,18 @@ module boa_stage_if#(
     wire [31:1] next_addr  = addr[31:1] + 1 + (insn[1:0] == 2'b11);
     // Next 16-bit word after address of requested instruction.
     wire [31:1] next_hw    = addr[31:1] + 1;
-    
-    assign if_next_pc = pc;
+    // Branch target buffer hit.
+    logic       btb_hit;
+    // Branch target buffer predicted address.
+    logic[31:1] btb_target;
+    // Return address stack hit.
+    logic       ras_hit;
+    // Return address stack predicted address.
+    logic[31:1] ras_target;
+    // Next instruction is predicted not to be sequential.
+    wire        pred_taken = ras_hit || btb_hit;
+    // Predicted address of the next instruction.
+    wire [31:1] pred_addr  = ras_hit ? ras_target : btb_hit ? btb_target : next_addr;
     
     generate if (if_branch_reg) begin: with_branch_reg
         // Branch is requested.
@@ -161,14 +190,19 @@ module boa_stage_if#(
     // Cache permission.
     cperm_t     cperm[cache_depth];
     
+    // A program bus read was requested.
+    logic       p_re;
+    
     // Cache writing logic.
+    // A read requested while the cache is cleared was checked with the old permissions and is dropped.
     assign icache[0] = pbus.rdata;
-    assign cvalid[0] = pbus.ready;
+    assign cvalid[0] = pbus.ready && p_re;
     always @(posedge clk) begin
+        p_re            <= !rst && pbus.re && !fw_cclear;
         acache[0]       <= pbus.addr;
         cperm[0]        <= {pmp.m_mode, pmp.x};
     end
-    wire cwrite = pbus.ready;
+    wire cwrite = cvalid[0];
     generate
         for (x = 1; x < cache_depth; x = x + 1) begin
             always @(posedge clk) begin
@@ -188,29 +222,138 @@ module boa_stage_if#(
     endgenerate
     
     // Cache reading logic.
-    logic       cvalidl;
+    logic       wvalidl;
     logic       cexpirel;
-    logic[31:0] crdatal;
-    cperm_t     cperml;
+    logic[31:0] wrdatal;
+    cperm_t     wperml;
     boa_stage_if_creader#(cache_depth) rl(
         cur_priv == 3, icache, acache, cvalid, cperm,
-        addr[31:2], cvalidl, cexpirel, crdatal, cperml
+        addr[31:2], wvalidl, cexpirel, wrdatal, wperml
     );
-    logic       cvalidh;
+    logic       wvalidh;
     logic       cexpireh;
-    logic[31:0] crdatah;
-    cperm_t     cpermh;
+    logic[31:0] wrdatah;
+    cperm_t     wpermh;
     boa_stage_if_creader#(cache_depth) rh(
         cur_priv == 3, icache, acache, cvalid, cperm,
-        next_hw[31:2], cvalidh, cexpireh, crdatah, cpermh
+        next_hw[31:2], wvalidh, cexpireh, wrdatah, wpermh
     );
+    
+    // L0 buffer lookup addresses: lower half, higher half, predicted next word and the word after it.
+    logic[31:2] l0_raddr[4];
+    // L0 buffer hit.
+    logic       l0_hit[4];
+    // L0 buffer read data.
+    logic[31:0] l0_rdata[4];
+    // L0 buffer read permission.
+    cperm_t     l0_rperm[4];
+    // Words needed after the current instruction are present.
+    logic       pf_valid[2];
+    assign l0_raddr[0] = addr[31:2];
+    assign l0_raddr[1] = next_hw[31:2];
+    assign l0_raddr[2] = pred_addr[31:2];
+    assign l0_raddr[3] = pred_addr[31:2] + 1;
+    generate
+        if (l0_depth) begin: l0
+            boa_stage_if_l0#(l0_depth, 4) buffer(
+                clk, rst || fence_i || fw_cclear, cur_priv == 3,
+                cvalid[0], acache[0], icache[0], cperm[0],
+                l0_raddr, l0_hit, l0_rdata, l0_rperm
+            );
+            for (x = 0; x < 2; x = x + 1) begin: pf
+                logic       wvalid;
+                logic       wexpire;
+                logic[31:0] wrdata;
+                cperm_t     wperm;
+                boa_stage_if_creader#(cache_depth) rp(
+                    cur_priv == 3, icache, acache, cvalid, cperm,
+                    l0_raddr[x+2], wvalid, wexpire, wrdata, wperm
+                );
+                assign pf_valid[x] = wvalid || l0_hit[x+2];
+            end
+        end else begin: nol0
+            for (x = 0; x < 4; x = x + 1) begin: stub
+                assign l0_hit[x]   = 0;
+                assign l0_rdata[x] = 'bx;
+                assign l0_rperm[x] = 'bx;
+            end
+            assign pf_valid[0] = 'bx;
+            assign pf_valid[1] = 'bx;
+        end
+    endgenerate
+    
+    // The fetch window takes precedence over the L0 buffer.
+    logic       cvalidl;
+    logic[31:0] crdatal;
+    cperm_t     cperml;
+    logic       cvalidh;
+    logic[31:0] crdatah;
+    cperm_t     cpermh;
+    assign cvalidl     = wvalidl || l0_hit[0];
+    assign crdatal     = wvalidl ? wrdatal : l0_rdata[0];
+    assign cperml      = wvalidl ? wperml  : l0_rperm[0];
+    assign cvalidh     = wvalidh || l0_hit[1];
+    assign crdatah     = wvalidh ? wrdatah : l0_rdata[1];
+    assign cpermh      = wvalidh ? wpermh  : l0_rperm[1];
     assign insn[15:0]  = addr[1]    ? crdatal[31:16] : crdatah[15:0];
     assign insn[31:16] = next_hw[1] ? crdatah[31:16] : crdatah[15:0];
     assign insn_valid  = cvalidl && (insn[1:0] != 2'b11 || cvalidh);
     
+    // Branch target buffer.
+    generate
+        if (btb_depth) begin: btb
+            logic btb_match;
+            boa_btb#(btb_depth) btb(
+                clk, rst,
+                addr, btb_match, btb_target,
+                fw_btb_we, fw_btb_pc, fw_btb_taken, fw_branch_target
+            );
+            assign btb_hit = btb_match && insn_valid;
+        end else begin: nobtb
+            assign btb_hit    = 0;
+            assign btb_target = 'bx;
+        end
+    endgenerate
+    
+    // Return address stack.
+    generate
+        if (ras_depth) begin: ras
+            // Instruction is a function return (JALR, C.JR or C.JALR with a link register as RS1).
+            logic is_ret;
+            always @(*) begin
+                if (insn[1:0] == 2'b11) begin
+                    is_ret = insn[6:2] == `RV_OP_JALR && insn[14:12] == 0
+                        && (insn[19:15] == 1 || insn[19:15] == 5)
+                        && (insn[11:7] != 1 && insn[11:7] != 5 || insn[11:7] != insn[19:15]);
+                end else begin
+                    is_ret = insn[1:0] == 2'b10 && insn[15:13] == 3'b100 && insn[6:2] == 0
+                        && (insn[12] ? insn[11:7] == 5 : insn[11:7] == 1 || insn[11:7] == 5);
+                end
+            end
+            logic ras_valid;
+            boa_ras#(ras_depth) ras(
+                clk, rst, !fw_stall_if,
+                fw_ras_push, fw_ras_pop, fw_ras_addr,
+                ras_valid, ras_target
+            );
+            assign ras_hit = is_ret && ras_valid && insn_valid;
+        end else begin: noras
+            assign ras_hit    = 0;
+            assign ras_target = 'bx;
+        end
+    endgenerate
+    
+    // Number of words the next sequential fetch is ahead of the current instruction.
+    // Sequential fetching stops before it would shift words still needed out of the fetch window,
+    // so the window keeps the current word and the next ones for misaligned 32-bit instructions.
+    wire [31:2] stream_ahead = acache[0][31:2] + 1 - addr[31:2];
+    
     // Program bus logic.
     assign pbus.we    = 0;
     assign pbus.wdata = 'bx;
+    assign pbus.blen  = 0;
+    assign pbus.bwrap = 0;
+    assign pbus.blast = 1;
     always @(*) begin
         if (rst || fence_i) begin
             // Reset; don't do anything.
@@ -224,10 +367,34 @@ module boa_stage_if#(
             // Fetch higher half of instruction.
             pbus.re         = 1;
             pbus.addr[31:2] = next_hw[31:2];
-        end else begin
+        end else if (l0_depth && !pf_valid[0]) begin
+            // Prefetch the predicted next instruction.
+            pbus.re         = 1;
+            pbus.addr[31:2] = l0_raddr[2];
+        end else if (l0_depth && !pf_valid[1]) begin
+            // Prefetch the word after the predicted next instruction.
+            pbus.re         = 1;
+            pbus.addr[31:2] = l0_raddr[3];
+        end else if (l0_depth) begin
+            // Everything needed is buffered; leave the program bus idle.
+            pbus.re         = 0;
+            pbus.addr       = 'bx;
+        end else if (pred_taken) begin
+            // Fetch the predicted branch target.
+            pbus.re         = 1;
+            pbus.addr[31:2] = pred_addr[31:2];
+        end else if (p_re && !pbus.ready) begin
+            // Keep presenting the last word until the program bus completes it.
+            pbus.re         = 1;
+            pbus.addr[31:2] = acache[0][31:2];
+        end else if (stream_ahead < cache_depth - 1) begin
             // Fetch the next word.
             pbus.re         = 1;
             pbus.addr[31:2] = acache[0][31:2] + 1;
+        end else begin
+            // The fetch window holds the current word and the ones after it; wait for it to be consumed.
+            pbus.re         = 0;
+            pbus.addr[31:2] = acache[0][31:2];
         end
     end
     
@@ -237,11 +404,12 @@ module boa_stage_if#(
     
     // Pipeline output logic.
     always @(*) begin
-        q_valid  = 0;
-        q_trap   = 0;
-        q_cause  = 'bx;
-        q_pc     = 'bx;
-        q_insn   = 'bx;
+        q_valid   = 0;
+        q_trap    = 0;
+        q_cause   = 'bx;
+        q_pc      = 'bx;
+        q_insn    = 'bx;
+        q_pred_pc = 'bx;
         if (!insn_valid || clear || fence_i || fw_cclear) begin
             // No results to give.
         end else if (!cperml.x || (!cpermh.x && insn[1:0] == 2'b11)) begin
@@ -251,9 +419,10 @@ module boa_stage_if#(
             q_pc    = addr;
         end else begin
             // Valid instruction.
-            q_valid = addr_valid;
-            q_pc    = addr;
-            q_insn  = insn;
+            q_valid   = addr_valid;
+            q_pc      = addr;
+            q_insn    = insn;
+            q_pred_pc = pred_addr;
         end
     end
     
@@ -261,7 +430,7 @@ module boa_stage_if#(
         if (rst) begin
             pc <= entrypoint[31:1];
         end else if (!fw_stall_if) begin
-            pc <= insn_valid ? next_addr : addr;
+            pc <= insn_valid ? pred_addr : addr;
         end
     end
 endmodule
@@ -321,3 +490,203 @@ module boa_stage_if_creader#(
     assign valid  = amatch != 0;
     assign expire = amask[depth-1];
 endmodule
+
+// L0 instruction buffer: direct-mapped store of fetched words, kept across control transfers.
+module boa_stage_if_l0#(
+    // Number of 4-byte words, a power of 2 of at least 2.
+    parameter  depth    = 16,
+    // Number of read ports.
+    parameter  ports    = 4,
+    // Number of index bits.
+    localparam abits    = $clog2(depth)
+)(
+    // CPU clock.
+    input  logic        clk,
+    // Synchronous reset; invalidates all entries.
+    input  logic        rst,
+    // Match M-mode.
+    input  logic        m_mode,
+    
+    // Write a fetched word.
+    input  logic        we,
+    // Address of the fetched word.
+    input  logic[31:2]  waddr,
+    // Fetched word.
+    input  logic[31:0]  wdata,
+    // Fetched word permission.
+    input  cperm_t      wperm,
+    
+    // Read addresses.
+    input  logic[31:2]  raddr[ports],
+    // Read hit.
+    output logic        hit[ports],
+    // Read data.
+    output logic[31:0]  rdata[ports],
+    // Read permission.
+    output cperm_t      rperm[ports]
+);
+    genvar x;
+    
+    // Entry validity.
+    logic               valid[depth];
+    // Entry address tags.
+    logic[31:abits+2]   tags[depth];
+    // Entry data.
+    logic[31:0]         data[depth];
+    // Entry permissions.
+    cperm_t             perms[depth];
+    
+    // Lookup logic.
+    generate
+        for (x = 0; x < ports; x = x + 1) begin: port
+            wire[abits-1:0] index = raddr[x][abits+1:2];
+            assign hit[x]   = valid[index] && tags[index] == raddr[x][31:abits+2] && perms[index].m_mode == m_mode;
+            assign rdata[x] = data[index];
+            assign rperm[x] = perms[index];
+        end
+    endgenerate
+    
+    // Update logic.
+    always @(posedge clk) begin
+        if (rst) begin
+            integer i;
+            for (i = 0; i < depth; i = i + 1) begin
+                valid[i] <= 0;
+            end
+        end else if (we) begin
+            valid[waddr[abits+1:2]] <= 1;
+            tags[waddr[abits+1:2]]  <= waddr[31:abits+2];
+            data[waddr[abits+1:2]]  <= wdata;
+            perms[waddr[abits+1:2]] <= wperm;
+        end
+    end
+endmodule
+
+
+
+// Branch target buffer: direct-mapped table of taken control transfer targets, looked up by instruction address.
+module boa_btb#(
+    // Number of entries, a power of 2 of at least 2.
+    parameter  depth    = 16,
+    // Number of index bits.
+    localparam abits    = $clog2(depth)
+)(
+    // CPU clock.
+    input  logic        clk,
+    // Synchronous reset.
+    input  logic        rst,
+    
+    // Address of the instruction to look up.
+    input  logic[31:1]  addr,
+    // Instruction is a control transfer predicted taken.
+    output logic        hit,
+    // Predicted target address.
+    output logic[31:1]  target,
+    
+    // Update an entry.
+    input  logic        we,
+    // Address of the control transfer to update.
+    input  logic[31:1]  waddr,
+    // Control transfer is predicted taken; the entry is removed otherwise.
+    input  logic        wtaken,
+    // Target address of the control transfer.
+    input  logic[31:1]  wtarget
+);
+    // Entry validity.
+    logic               valid[depth];
+    // Entry address tags.
+    logic[31:abits+1]   tags[depth];
+    // Entry target addresses.
+    logic[31:1]         targets[depth];
+    
+    // Lookup logic.
+    assign hit    = valid[addr[abits:1]] && tags[addr[abits:1]] == addr[31:abits+1];
+    assign target = targets[addr[abits:1]];
+    
+    // Update logic.
+    always @(posedge clk) begin
+        if (rst) begin
+            integer i;
+            for (i = 0; i < depth; i = i + 1) begin
+                valid[i] <= 0;
+            end
+        end else if (we) begin
+            valid[waddr[abits:1]]   <= wtaken;
+            tags[waddr[abits:1]]    <= waddr[31:abits+1];
+            targets[waddr[abits:1]] <= wtarget;
+        end
+    end
+endmodule
+
+
+
+// Return address stack: predicts function return addresses.
+// Pushes and pops are requested by ID and are already reflected in the output while pending.
+module boa_ras#(
+    // Number of entries, a power of 2 of at least 2.
+    parameter  depth    = 4,
+    // Number of stack pointer bits.
+    localparam abits    = $clog2(depth)
+)(
+    // CPU clock.
+    input  logic        clk,
+    // Synchronous reset.
+    input  logic        rst,
+    // Apply the pending push and/or pop.
+    input  logic        en,
+    
+    // Push a return address; done after the pop if both are requested.
+    input  logic        push,
+    // Pop a return address.
+    input  logic        pop,
+    // Return address to push.
+    input  logic[31:1]  paddr,
+    
+    // The stack is not empty.
+    output logic        valid,
+    // Predicted return address.
+    output logic[31:1]  top
+);
+    // Return address storage; overflow overwrites the oldest entries.
+    logic[31:1]         stack[depth];
+    // Index of the top entry.
+    logic[abits-1:0]    sp;
+    // Number of valid entries.
+    logic[abits:0]      count;
+    // Index of the entry above the top.
+    wire [abits-1:0]    sp_inc = sp + 1;
+    // Index of the entry below the top.
+    wire [abits-1:0]    sp_dec = sp - 1;
+    
+    // Lookahead logic.
+    always @(*) begin
+        if (push) begin
+            valid = 1;
+            top   = paddr;
+        end else if (pop) begin
+            valid = count > 1;
+            top   = stack[sp_dec];
+        end else begin
+            valid = count != 0;
+            top   = stack[sp];
+        end
+    end
+    
+    // Update logic.
+    always @(posedge clk) begin
+        if (rst) begin
+            sp    <= 0;
+            count <= 0;
+        end else if (en && push && pop) begin
+            stack[sp] <= paddr;
+            count     <= count ? count : 1;
+        end else if (en && push) begin
+            sp            <= sp_inc;
+            stack[sp_inc] <= paddr;
+            count         <= count == depth ? count : count + 1;
+        end else if (en && pop) begin
+            sp    <= sp_dec;
+            count <= count ? count - 1 : 0;
+        end
+    end
+endmodule
@@ -11,7 +11,21 @@ module boa_stage_mem#(
     // Support A (atomic memory operation) instructions.
     parameter has_a         = 1,
     // Enable additional latch for RMW AMOs.
-    parameter rmw_amo_reg   = 0
+    parameter rmw_amo_reg   = 0,
+    // Support cache-block management instructions (Zicbom).
+    parameter has_zicbom    = 0,
+    // Support cache-block prefetch hints (Zicbop).
+    parameter has_zicbop    = 0,
+    // Number of store buffer entries, 0 to disable.
+    parameter sbuf_depth    = 0,
+    // CPU-local memory-mapped I/O address; the store buffer keeps accesses to its 4K page in order.
+    parameter cpummio       = 32'hff00_0000,
+    // Base address of the memory-mapped I/O range the store buffer keeps in order.
+    parameter io_base       = 32'h0000_0000,
+    // Number of address bits in the memory-mapped I/O range, 0 for only the cpummio page.
+    parameter io_bits       = 0,
+    // Support misaligned loads and stores by splitting them into two accesses.
+    parameter misaligned    = 0
 )(
     // CPU clock.
     input  logic        clk,
@@ -28,6 +42,9 @@ module boa_stage_mem#(
     boa_mem_bus.CPU     dbus,
     // PMP checking bus.
     boa_pmp_bus.CPU     pmp,
+    // PMP checking bus for the second word of misaligned accesses.
+    // Never used if misaligned isn't enabled.
+    boa_pmp_bus.CPU     pmp_hi,
     // CSR access bus.
     boa_csr_bus.CPU     csr,
     // Current memory access is an AMO (disable caches).
@@ -41,6 +58,16 @@ module boa_stage_mem#(
     output logic        fence_rl,
     // Perform an acquire data fence.
     output logic        fence_aq,
+    // Invalidate the cache block at cmo_addr.
+    output logic        cmo_inval,
+    // Write back the cache block at cmo_addr.
+    output logic        cmo_clean,
+    // Prefetch the cache block at cmo_addr.
+    output logic        cmo_prefetch,
+    // Cache-block operation address.
+    output logic[31:0]  cmo_addr,
+    // A data fence or cache-block operation is in progress or is started by the request made this cycle.
+    input  logic        cmo_busy,
     
     
     // EX/MEM: Result valid.
@@ -140,20 +167,68 @@ module boa_stage_mem#(
     
     
     /* ==== Fence logic ==== */
+    // Is a CBO.INVAL, CBO.CLEAN or CBO.FLUSH instruction.
+    wire        d_is_cbo        = has_zicbom && d_insn[6:2] == `RV_OP_MISC_MEM && d_insn[14:12] == 2;
+    // Is a CBO.INVAL, CBO.CLEAN or CBO.FLUSH instruction.
+    wire        r_is_cbo        = has_zicbom && r_insn[6:2] == `RV_OP_MISC_MEM && r_insn[14:12] == 2;
+    // Is a FENCE or cache-block management instruction.
+    wire        r_is_sync       = (r_insn[6:2] == `RV_OP_MISC_MEM && r_insn[14:12] == 0) || r_is_cbo;
+    // Is a PREFETCH.I, PREFETCH.R or PREFETCH.W hint.
+    wire        r_is_prefetch   = has_zicbop && r_insn[6:2] == `RV_OP_OP_IMM && r_insn[14:12] == `RV_ALU_OR && r_insn[11:7] == 0;
+    // PMP read permission for the prefetch address.
+    logic       r_prefetch_ok;
+    // The FENCE or cache-block operation has been sent and is waiting to complete.
+    logic       cmo_sent;
+    // An operation was in progress last cycle; it may not have completed yet.
+    logic       cmo_busy_q;
+    // There are buffered stores that have not been written yet.
+    logic       sbuf_busy;
+    // The memory access in MEM has not completed yet.
+    logic       mem_busy;
+    // The FENCE or cache-block operation is sent this cycle.
+    // It waits for buffered stores and for any previous operation, which is known from last cycle's cmo_busy.
+    wire        cmo_send        = r_valid && r_is_sync && !trap && !clear && !rst && !cmo_sent && !sbuf_busy && !cmo_busy_q;
+    // Waiting to send the FENCE or cache-block operation, or for the operation it started to complete.
+    // If it started none, cmo_busy stays low and the instruction does not wait.
+    wire        cmo_stall       = r_valid && r_is_sync && !trap && (!cmo_sent && !cmo_send || cmo_busy);
+    
+    assign cmo_addr = r_rs1_val;
+    always @(posedge clk) begin
+        if (!fw_stall_mem) begin
+            r_prefetch_ok <= pmp.r;
+        end
+        cmo_sent   <= !rst && !clear && cmo_stall && (cmo_sent || cmo_send);
+        cmo_busy_q <= !rst && cmo_busy;
+    end
+    
     // Is this a FENCE instruction?
     always @(*) begin
-        fence_aq = 0;
-        fence_rl = 0;
-        if (!r_valid || clear || rst || fw_stall_mem) begin
+        fence_aq        = 0;
+        fence_rl        = 0;
+        cmo_inval       = 0;
+        cmo_clean       = 0;
+        cmo_prefetch    = 0;
+        if (!r_valid || clear || rst || trap) begin
             // Invalid instruction, no fencing.
+        end else if (r_is_sync && !cmo_send) begin
+            // FENCE or cache-block operation already sent or waiting for the previous one or the store buffer.
         end else if (r_insn[6:2] == `RV_OP_MISC_MEM && r_insn[14:12] == 0) begin
             // FENCE instruction.
             fence_aq = r_insn[27:24] != 0;
             fence_rl = r_insn[23:20] != 0;
+        end else if (r_is_cbo) begin
+            // CBO.INVAL, CBO.CLEAN and CBO.FLUSH instructions.
+            cmo_inval = r_insn[21:20] != 1;
+            cmo_clean = r_insn[21:20] != 0;
+        end else if (mem_busy) begin
+            // Memory access not done yet, no fencing.
         end else if (has_a && r_insn[6:2] == `RV_OP_AMO) begin
             // AMO instruction.
             fence_aq = r_insn[26];
             fence_rl = r_insn[25];
+        end else if (r_is_prefetch && r_prefetch_ok) begin
+            // PREFETCH.R and PREFETCH.W hints; PREFETCH.I is ignored.
+            cmo_prefetch = r_insn[24:20] == 1 || r_insn[24:20] == 3;
         end
     end
     
@@ -168,11 +243,21 @@ module boa_stage_mem#(
     logic[3:0]  resv_age;
     // Whether a SC was successfull.
     logic       sc_success;
+    // The write of the SC in MEM was not accepted yet; its reservation is checked again until it is.
+    logic       sc_hold;
     
     generate
         if (has_a) begin: a
+            // The reservation is requested for the LR address and kept for the address it was made for.
+            assign resv_bus.addr = resv_valid || sc_hold ? resv_addr : d_addr[31:2];
             always @(*) begin
-                if (!d_valid || trap || clear) begin
+                resv_bus.sc     = 0;
+                if (sc_hold) begin
+                    // SC write not accepted yet; another write to the granule before it is accepted makes the SC fail.
+                    resv_bus.req    = 1;
+                    resv_bus.sc     = 1;
+                    resv_keep       = 0;
+                end else if (!d_valid || trap || clear) begin
                     // Invalid instruction, no memory access.
                     resv_bus.req    = resv_valid;
                     resv_keep       = 1;
@@ -195,6 +280,7 @@ module boa_stage_mem#(
                 end else if (has_a && d_insn[6:2] == `RV_OP_AMO && d_insn[28:27] == 2'b11) begin
                     // SC instructions.
                     resv_bus.req    = resv_valid;
+                    resv_bus.sc     = 1;
                     resv_keep       = 0;
                 end else begin
                     // Other instructions.
@@ -214,13 +300,16 @@ module boa_stage_mem#(
                 if (resv_valid && d_valid && !trap && !clear) begin
                     resv_age    <= resv_age + 1;
                 end
-                if (!resv_valid && resv_bus.req) begin
+                if (!resv_valid && !sc_hold && resv_bus.req) begin
                     // Reservation outdated.
                     resv_addr   <= d_addr[31:2];
                     resv_age    <= 0;
                 end
                 
-                if (!d_valid || trap || clear) begin
+                if (sc_hold) begin
+                    // SC write not accepted yet; it is dropped if the reservation was lost.
+                    sc_success  <= sc_success && resv_bus.valid;
+                end else if (!d_valid || trap || clear) begin
                     // Invalid instruction, no memory access.
                 end else if (has_a && d_insn[6:2] == `RV_OP_AMO && d_insn[28:27] == 2'b11) begin
                     // SC instructions.
@@ -228,11 +317,13 @@ module boa_stage_mem#(
                 end
             end
         end else begin: not_a
-            assign resv_bus.req = 0;
-            assign resv_keep    = 'bx;
-            assign resv_valid   = 0;
-            assign resv_addr    = 'bx;
-            assign resv_age     = 'bx;
+            assign resv_bus.req  = 0;
+            assign resv_bus.addr = 'bx;
+            assign resv_bus.sc   = 0;
+            assign resv_keep     = 'bx;
+            assign resv_valid    = 0;
+            assign resv_addr     = 'bx;
+            assign resv_age      = 'bx;
         end
     endgenerate
     
@@ -277,8 +368,23 @@ module boa_stage_mem#(
         end
     end
     
-    assign pmp.m_mode = mem_priv == 3;
-    assign pmp.addr   = d_addr >> 2;
+    assign pmp.m_mode    = mem_priv == 3;
+    assign pmp.addr      = d_addr >> 2;
+    assign pmp_hi.m_mode = mem_priv == 3;
+    assign pmp_hi.addr   = (d_addr >> 2) + 1;
+    
+    // Is an AMO instruction.
+    wire        d_is_amo    = has_a && d_insn[6:2] == `RV_OP_AMO;
+    // Is an AMO instruction.
+    wire        r_is_amo    = has_a && r_insn[6:2] == `RV_OP_AMO;
+    // Is an SC instruction.
+    wire        d_is_sc     = d_is_amo && d_insn[28:27] == 2'b11;
+    // The access crosses a word boundary, so both words need permission.
+    wire        d_cross     = misaligned && !d_is_amo && (d_asize == 1 ? d_addr[1:0] == 3 : d_asize == 2 && d_addr[1:0] != 0);
+    // PMP read permission for all words accessed.
+    wire        d_pmp_r     = pmp.r && (!d_cross || pmp_hi.r);
+    // PMP write permission for all words accessed.
+    wire        d_pmp_w     = pmp.w && (!d_cross || pmp_hi.w);
     
     // Enable RMW logic.
     logic       r_rmw_en;
@@ -288,6 +394,8 @@ module boa_stage_mem#(
     logic       r_re;
     // Write enable.
     logic       r_we;
+    // Access is an SC.
+    logic       r_sc;
     // Access is signed.
     logic       r_sign;
     // Access size.
@@ -303,6 +411,9 @@ module boa_stage_mem#(
     
     // Memory register select.
     wire        rsel    = (r_re || r_we || r_rmw_en) && !ready;
+    assign      sc_hold = has_a && r_sc && r_we && !ready;
+    // The held SC lost its reservation before its write was accepted; the write is dropped.
+    wire        sc_drop = sc_hold && !resv_bus.valid;
     
     always @(posedge clk) begin
         if (rst || clear) begin
@@ -311,6 +422,7 @@ module boa_stage_mem#(
             r_amo_en    <= 0;
             r_re        <= 0;
             r_we        <= 0;
+            r_sc        <= 0;
             r_sign      <= 'bx;
             r_asize     <= 'bx;
             r_addr      <= 'bx;
@@ -323,35 +435,58 @@ module boa_stage_mem#(
             r_amo_en    <= d_amo_en;
             r_re        <= d_re;
             r_we        <= d_we;
+            r_sc        <= d_is_sc;
             r_sign      <= d_sign;
             r_asize     <= d_asize;
             r_addr      <= d_addr;
             r_wdata     <= d_wdata;
-            r_pmp_r     <= pmp.r;
-            r_pmp_w     <= pmp.w;
+            r_pmp_r     <= d_pmp_r;
+            r_pmp_w     <= d_pmp_w;
+        end else if (sc_drop) begin
+            // The SC failed; nothing is left to wait for.
+            r_we        <= 0;
         end
     end
     
-    assign amo_en = rsel ? r_amo_en : d_amo_en;
-    boa_stage_mem_access#(.has_a(has_a), .rmw_amo_reg(rmw_amo_reg)) mem_if(
+    // Memory bus between the access logic and the store buffer.
+    boa_mem_bus mem_bus();
+    // Atomic memory access presented by the access logic.
+    wire  mem_amo_en = rsel ? r_amo_en : d_amo_en;
+    // Access presented by the access logic is to memory-mapped I/O.
+    wire  mem_io     = mem_bus.addr[31:12] == cpummio[31:12]
+                    || io_bits != 0 && {mem_bus.addr, 2'b00} >> io_bits == io_base >> io_bits;
+    boa_stage_mem_access#(.has_a(has_a), .rmw_amo_reg(rmw_amo_reg), .misaligned(misaligned)) mem_if(
         clk, rst,
-        rsel ? r_rmw_en && r_pmp_r && r_pmp_w : d_rmw_en && pmp.r && pmp.w,
+        rsel ? r_rmw_en && r_pmp_r && r_pmp_w : d_rmw_en && d_pmp_r && d_pmp_w,
         rsel ? r_insn[31:29]    : d_insn[31:29],
-        rsel ? r_re && r_pmp_r  : d_re && pmp.r,
-        rsel ? r_we && r_pmp_w  : d_we && pmp.w,
+        rsel ? r_is_amo         : d_is_amo,
+        rsel ? r_re && r_pmp_r  : d_re && d_pmp_r,
+        rsel ? r_we && r_pmp_w && !sc_drop : d_we && d_pmp_w,
         rsel ? r_sign           : d_sign,
         rsel ? r_asize          : d_asize,
         rsel ? r_addr           : d_addr,
         rsel ? r_wdata          : d_wdata,
         ealign, ready, rdata,
-        dbus
+        mem_bus
     );
     
+    // Store buffer; AMOs, accesses between LR and SC and memory-mapped I/O accesses are kept in order with buffered stores.
+    // Stores to memory-mapped I/O are never buffered, so nothing overtakes them and they reach the device in program order.
+    generate
+        if (sbuf_depth > 0) begin: sbuf
+            boa_stage_mem_sbuf#(sbuf_depth) sbuf(clk, rst, mem_bus, dbus, mem_amo_en, mem_amo_en || resv_valid || mem_io, amo_en, sbuf_busy);
+        end else begin: no_sbuf
+            boa_mem_connector sbuf(dbus, mem_bus);
+            assign amo_en    = mem_amo_en;
+            assign sbuf_busy = 0;
+        end
+    endgenerate
+    
     // Permission checking logic.
     wire  pmp_re    = rsel ? r_re : d_re;
     wire  pmp_we    = rsel ? (r_we || r_amo_en) : (d_we || d_amo_en);
-    wire  pmp_r     = rsel ? r_pmp_r : pmp.r;
-    wire  pmp_w     = rsel ? r_pmp_w : pmp.w;
+    wire  pmp_r     = rsel ? r_pmp_r : d_pmp_r;
+    wire  pmp_w     = rsel ? r_pmp_w : d_pmp_w;
     
     
     /* ==== CSR access logic ==== */
@@ -408,6 +543,11 @@ module boa_stage_mem#(
             trap    <= 1;
             cause   <= `RV_ECAUSE_LACCESS;
             
+        end else if (d_is_cbo && (d_insn[21:20] == 0 ? !pmp.w : !pmp.r && !pmp.w)) begin
+            // Cache-block operation access fault.
+            trap    <= d_valid;
+            cause   <= `RV_ECAUSE_SACCESS;
+            
         end else if ((mem_if.re || mem_if.we) && mem_if.ealign) begin
             // Memory alignment error.
             trap    <= mem_if.ealign;
@@ -426,7 +566,8 @@ module boa_stage_mem#(
     
     
     // Pipeline barrier logic.
-    assign  stall_req   = (r_re || r_we || r_rmw_en) && !mem_if.ready;
+    assign  mem_busy    = (r_re || r_we || r_rmw_en) && !mem_if.ready;
+    assign  stall_req   = mem_busy || cmo_stall;
     assign  q_valid     = r_valid && !trap && !clear;
     assign  q_pc        = r_pc;
     assign  q_insn      = r_insn;
@@ -561,7 +702,9 @@ module boa_stage_mem_access#(
     // Support A (atomic memory operation) instructions.
     parameter has_a         = 1,
     // Enable additional latch for RMW AMOs.
-    parameter rmw_amo_reg   = 0
+    parameter rmw_amo_reg   = 0,
+    // Support misaligned loads and stores by splitting them into two accesses.
+    parameter misaligned    = 0
 )(
     // CPU clock.
     input  logic        clk,
@@ -572,6 +715,8 @@ module boa_stage_mem_access#(
     input  logic        rmw_en,
     // Mode for RMW AMOs.
     input  logic[2:0]   rmw_mode,
+    // Access is atomic; misaligned atomic accesses are always an alignment error.
+    input  logic        amo,
     
     // Read enable.
     input  logic        re,
@@ -596,18 +741,36 @@ module boa_stage_mem_access#(
     // Memory bus.
     boa_mem_bus.CPU     bus
 );
-    assign bus.addr[31:2] = addr[31:2];
-    
     // Memory write data.
     logic[31:0] wdata;
     
-    // RMW AMO phase; 0 is read, 1 is delay, 2 is modify/write.
+    // RMW AMO stage; 0 is idle, 1 is read, 2 is repeated read, 3 is modify/write.
+    // The repeated read is only used with rmw_amo_reg, to give the read data a cycle before the write without leaving the bus idle.
     logic[1:0]  amo_stage;
+    // RMW AMO stage of the access presented; the access of the current stage is held until the bus is ready.
+    logic[1:0]  amo_phase;
     // RMW AMO read data latch.
     logic[31:0] amo_rdata_reg;
     // RMW AMO write data.
     logic[31:0] amo_wdata;
     
+    // Misaligned access stage; 0 is idle, 1 is first word, 2 is second word.
+    logic[1:0]  mis_stage;
+    // Misaligned access stage of the access presented; the access of the current stage is held until the bus is ready.
+    logic[1:0]  mis_phase;
+    // Misaligned access first word read data latch.
+    logic[31:0] mis_rdata;
+    // The access is misaligned and supported.
+    wire        mis_en      = misaligned && (re || we) && !amo && (asize == 2'b01 ? addr[0] : asize == 2'b10 && addr[1:0] != 0);
+    // The access is misaligned and crosses a word boundary, so it is split into two accesses.
+    wire        mis_split   = mis_en && (asize == 2'b01 ? addr[1:0] == 2'b11 : 1);
+    // Write enables of the misaligned access in the two words.
+    wire [7:0]  mis_we      = (asize == 2'b01 ? 8'b0000_0011 : 8'b0000_1111) << addr[1:0];
+    // Write data of the misaligned access in the two words.
+    wire [63:0] mis_wdata   = {32'h0000_0000, wdata} << (addr[1:0] * 8);
+    // Read data of the misaligned access, shifted down to bit 0.
+    logic[63:0] mis_word;
+    
     // Latch the req.
     logic       sign_reg;
     logic[1:0]  asize_reg;
@@ -619,29 +782,78 @@ module boa_stage_mem_access#(
             addr_reg        <= 'bx;
             amo_stage       <= 0;
             amo_rdata_reg   <= 'bx;
+            mis_stage       <= 0;
+            mis_rdata       <= 'bx;
         end else begin
             sign_reg    <= sign;
             asize_reg   <= asize;
             addr_reg    <= addr[1:0];
-            if (has_a && rmw_en && amo_stage == 0) begin
-                // Transistion from read to delay or modify/write.
-                amo_stage       <= rmw_amo_reg ? 1 : 2;
-            end else if (has_a && rmw_amo_reg && amo_stage == 1) begin
-                // Transision from delay to modify/write.
-                amo_stage       <= 2;
-                amo_rdata_reg   <= bus.rdata;
-            end else if (has_a && rmw_en && bus.ready) begin
-                // Transition from modify/write to idle or read.
+            if (has_a && rmw_en) begin
+                // Advance to the stage of the access presented; a read that was just presented is now held.
+                amo_stage       <= amo_phase == 0 ? 1 : amo_phase;
+            end else begin
+                // Not an RMW AMO.
                 amo_stage       <= 0;
+            end
+            if (has_a && amo_stage == 1 && bus.ready) begin
+                // Read completed.
                 amo_rdata_reg   <= bus.rdata;
             end
+            if (mis_split) begin
+                // Advance to the stage of the access presented; a first word that was just presented is now held.
+                mis_stage       <= mis_phase == 0 ? 1 : mis_phase;
+            end else begin
+                // Not split.
+                mis_stage       <= 0;
+            end
+            if (misaligned && mis_stage == 1 && bus.ready) begin
+                // First word completed.
+                mis_rdata       <= bus.rdata;
+            end
+        end
+    end
+    
+    // Misaligned access sequencing logic.
+    always @(*) begin
+        if (!misaligned || !bus.ready) begin
+            // Keep presenting the same access.
+            mis_phase = mis_stage;
+        end else if (mis_stage == 1) begin
+            // First word completed; access the second word.
+            mis_phase = 2;
+        end else begin
+            // Second word completed or idle; the next access starts with its first word.
+            mis_phase = 0;
+        end
+    end
+    
+    // RMW AMO sequencing logic.
+    always @(*) begin
+        if (!has_a || !bus.ready) begin
+            // Keep presenting the same access.
+            amo_phase = amo_stage;
+        end else if (amo_stage == 1) begin
+            // Read completed; repeat it or write.
+            amo_phase = rmw_amo_reg ? 2 : 3;
+        end else if (amo_stage == 2) begin
+            // Repeated read completed; write.
+            amo_phase = 3;
+        end else begin
+            // Write completed or idle; the next access starts with its read.
+            amo_phase = 0;
         end
     end
     
+    // RMW AMOs are presented as a two-beat burst so that shared buses keep the read and the write together.
+    assign bus.addr[31:2] = addr[31:2] + (misaligned && mis_phase == 2);
+    assign bus.blen       = has_a && rmw_en ? 1 : 0;
+    assign bus.bwrap      = 0;
+    assign bus.blast      = !(has_a && rmw_en) || amo_phase == 3;
+    
     // Write data logic.
     generate
         if (has_a && !rmw_amo_reg) begin: a0
-            boa_stage_mem_rmw rmw(rmw_mode, bus.ready ? bus.rdata : amo_rdata_reg, wmask, amo_wdata);
+            boa_stage_mem_rmw rmw(rmw_mode, amo_stage == 1 ? bus.rdata : amo_rdata_reg, wmask, amo_wdata);
             assign wdata = rmw_en ? amo_wdata : wmask;
         end else if (has_a) begin: a1
             boa_stage_mem_rmw rmw(rmw_mode, amo_rdata_reg, wmask, amo_wdata);
@@ -656,15 +868,22 @@ module boa_stage_mem_access#(
         bit re_tmp, we_tmp;
         if (has_a && rmw_en) begin
             // Divide RMW AMOs into two accesses.
-            re_tmp = amo_stage != 2;
-            we_tmp = amo_stage == 2;
+            re_tmp = amo_phase != 3;
+            we_tmp = amo_phase == 3;
         end else begin
             // NON-RMW AMO or normal access.
             re_tmp = re;
             we_tmp = we;
         end
         
-        if (asize == 2'b00) begin
+        if (mis_en) begin
+            // Misaligned access; the part in the second word is accessed separately.
+            ealign              = 0;
+            bus.re              = re_tmp;
+            bus.we              = !we_tmp ? 4'b0000 : mis_phase == 2 ? mis_we[7:4] : mis_we[3:0];
+            bus.wdata           = mis_phase == 2 ? mis_wdata[63:32] : mis_wdata[31:0];
+            
+        end else if (asize == 2'b00) begin
             // 8-bit access.
             ealign              = 0;
             bus.re              = re_tmp;
@@ -706,15 +925,28 @@ module boa_stage_mem_access#(
     
     // Response logic.
     always @(*) begin
-        if (has_a && amo_stage) begin
+        if (has_a && (amo_stage == 1 || amo_stage == 2)) begin
             // Override ready to 0 so the CPU waits for the write access too.
             ready = 0;
+        end else if (misaligned && mis_stage == 1) begin
+            // Override ready to 0 so the CPU waits for the second word too.
+            ready = 0;
         end else begin
             // Normal access or second half of RMW.
             ready = bus.ready;
         end
         
-        if (asize_reg == 2'b00) begin
+        mis_word = (mis_stage == 2 ? {bus.rdata, mis_rdata} : {32'bx, bus.rdata}) >> (addr_reg * 8);
+        if (misaligned && (asize_reg == 2'b01 ? addr_reg[0] : asize_reg == 2'b10 && addr_reg != 0)) begin
+            // Misaligned access; the first word was latched if the access was split.
+            if (asize_reg == 2'b01) begin
+                rdata[15:0]     = mis_word[15:0];
+                rdata[31:16]    = (sign_reg && rdata[15]) ? 16'hffff : 16'h0000;
+            end else begin
+                rdata           = mis_word[31:0];
+            end
+            
+        end else if (asize_reg == 2'b00) begin
             // 8-bit access.
             case (addr_reg)
                 2'b00: rdata[7:0] = bus.rdata[7:0];
@@ -734,12 +966,186 @@ module boa_stage_mem_access#(
             rdata[31:16]    = (sign_reg && rdata[15]) ? 16'hffff : 16'h0000;
             
         end else if (asize_reg == 2'b10) begin
-            // 32-bit access.
-            rdata           = bus.rdata;
-            
+            // 32-bit access; RMW AMOs return the value read before the write.
+            rdata           = has_a && amo_stage == 3 ? amo_rdata_reg : bus.rdata;
+        
         end else begin
             // Illegal instruction.
             rdata   = 'bx;
         end
     end
 endmodule
+
+
+// Store buffer: stores complete as soon as they are presented and are written to memory while it is otherwise idle.
+// Reads may overtake buffered stores to other words; a read of a word with buffered stores is answered from the buffer
+// if they cover the whole word, otherwise it waits until they are written.
+// Ordered accesses and bursts wait until the buffer is empty and are never buffered; stores wait while the buffer is full.
+module boa_stage_mem_sbuf#(
+    // Number of store buffer entries, at least 1.
+    parameter  depth    = 2,
+    // Number of bits in an entry index.
+    localparam ilen     = depth > 1 ? $clog2(depth) : 1
+)(
+    // CPU clock.
+    input  logic        clk,
+    // Synchronous reset.
+    input  logic        rst,
+    
+    // Memory bus from the memory access logic.
+    boa_mem_bus.MEM     cpu,
+    // Data memory bus.
+    boa_mem_bus.CPU     mem,
+    
+    // The access presented is an AMO.
+    input  logic        amo_in,
+    // The access presented must not be buffered or overtake buffered stores.
+    input  logic        ordered,
+    // The access presented on the data memory bus is an AMO.
+    output logic        amo_out,
+    // There are buffered stores that have not been written yet.
+    output logic        busy
+);
+    // Nothing presented on the data memory bus.
+    localparam dn_idle  = 0;
+    // Oldest buffered store presented on the data memory bus.
+    localparam dn_drain = 1;
+    // Access from the memory access logic presented on the data memory bus.
+    localparam dn_fwd   = 2;
+    
+    // Buffered store write enables.
+    logic[3:0]      sb_we[depth];
+    // Buffered store addresses.
+    logic[31:2]     sb_addr[depth];
+    // Buffered store data.
+    logic[31:0]     sb_wdata[depth];
+    // Index of the oldest buffered store.
+    logic[ilen-1:0] head;
+    // Number of buffered stores.
+    logic[ilen:0]   count;
+    
+    // What was presented on the data memory bus last cycle.
+    logic[1:0]      dn_state;
+    // What to present on the data memory bus next cycle.
+    logic[1:0]      dn_next;
+    // The access presented last cycle was neither buffered, answered nor passed on.
+    logic           cpu_wait;
+    // The read presented last cycle was answered from the buffer.
+    logic           cpu_local;
+    // Read data answered from the buffer.
+    logic[31:0]     local_rdata;
+    
+    // The access presented on the data memory bus last cycle completes or there was none.
+    wire            dn_free     = dn_state == dn_idle || mem.ready;
+    // The oldest buffered store completes.
+    wire            drained     = dn_state == dn_drain && mem.ready;
+    // Number of buffered stores after the oldest one completes.
+    wire [ilen:0]   left        = count - drained;
+    // Index of the oldest buffered store after the oldest one completes.
+    wire [ilen-1:0] dn_slot     = (head + drained) % depth;
+    // Index of the next free entry.
+    wire [ilen-1:0] tail        = (head + count) % depth;
+    
+    // The memory access logic presents an access that is not already on the data memory bus.
+    wire            cpu_req     = (cpu.re || cpu.we != 0) && !(dn_state == dn_fwd && !mem.ready);
+    // The access presented is a store that may be buffered.
+    wire            cpu_store   = cpu.we != 0 && !cpu.re && cpu.blen == 0 && !ordered;
+    // The access presented is a read that may overtake buffered stores.
+    wire            cpu_load    = cpu.re && cpu.we == 0 && cpu.blen == 0 && !ordered;
+    
+    // Bytes of the word presented covered by buffered stores.
+    logic[3:0]      hit_we;
+    // Data of the word presented from buffered stores.
+    logic[31:0]     hit_data;
+    always @(*) begin
+        integer i, j;
+        hit_we   = 0;
+        hit_data = 'bx;
+        // Younger stores override older stores.
+        for (i = 0; i < depth; i = i + 1) begin
+            if (i >= drained && i < count && sb_addr[(head + i) % depth] == cpu.addr) begin
+                for (j = 0; j < 4; j = j + 1) begin
+                    if (sb_we[(head + i) % depth][j]) begin
+                        hit_data[j*8 +: 8] = sb_wdata[(head + i) % depth][j*8 +: 8];
+                    end
+                end
+                hit_we |= sb_we[(head + i) % depth];
+            end
+        end
+    end
+    
+    // The store presented is buffered.
+    wire            cpu_buffer  = cpu_req && cpu_store && left < depth;
+    // The read presented is answered from the buffer.
+    wire            cpu_hit     = cpu_req && cpu_load && hit_we == 4'b1111;
+    // The access presented is passed on to the data memory bus.
+    wire            cpu_fwd     = cpu_req && !cpu_store && !cpu_hit && dn_free && (cpu_load ? hit_we == 0 : left == 0);
+    
+    // Data memory bus logic.
+    always @(*) begin
+        if (cpu_fwd || !dn_free && dn_state == dn_fwd) begin
+            // Pass on the access from the memory access logic.
+            dn_next     = dn_fwd;
+            mem.re      = cpu.re;
+            mem.we      = cpu.we;
+            mem.addr    = cpu.addr;
+            mem.wdata   = cpu.wdata;
+            mem.blen    = cpu.blen;
+            mem.bwrap   = cpu.bwrap;
+            mem.blast   = cpu.blast;
+            amo_out     = amo_in;
+        end else if (!dn_free || left != 0) begin
+            // Write the oldest buffered store.
+            dn_next     = dn_drain;
+            mem.re      = 0;
+            mem.we      = sb_we[dn_slot];
+            mem.addr    = sb_addr[dn_slot];
+            mem.wdata   = sb_wdata[dn_slot];
+            mem.blen    = 0;
+            mem.bwrap   = 0;
+            mem.blast   = 1;
+            amo_out     = 0;
+        end else begin
+            // Idle.
+            dn_next     = dn_idle;
+            mem.re      = 0;
+            mem.we      = 0;
+            mem.addr    = 'bx;
+            mem.wdata   = 'bx;
+            mem.blen    = 0;
+            mem.bwrap   = 0;
+            mem.blast   = 1;
+            amo_out     = 0;
+        end
+    end
+    
+    // Memory access logic bus logic.
+    assign cpu.ready    = dn_state == dn_fwd ? mem.ready : !cpu_wait;
+    assign cpu.rdata    = cpu_local ? local_rdata : mem.rdata;
+    assign busy         = count != 0;
+    
+    always @(posedge clk) begin
+        if (rst) begin
+            head        <= 0;
+            count       <= 0;
+            dn_state    <= dn_idle;
+            cpu_wait    <= 0;
+            cpu_local   <= 0;
+            local_rdata <= 'bx;
+        end else begin
+            if (drained) begin
+                head        <= (head + 1) % depth;
+            end
+            if (cpu_buffer) begin
+                sb_we[tail]     <= cpu.we;
+                sb_addr[tail]   <= cpu.addr;
+                sb_wdata[tail]  <= cpu.wdata;
+            end
+            count       <= left + cpu_buffer;
+            dn_state    <= dn_next;
+            cpu_wait    <= cpu_req && !cpu_buffer && !cpu_hit && !cpu_fwd;
+            cpu_local   <= cpu_hit;
+            local_rdata <= hit_data;
+        end
+    end
+endmodule
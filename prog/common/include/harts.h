@@ -0,0 +1,13 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of harts register, reads as 0 on single-hart designs without it.
+extern uint32_t const    NUM_HARTS asm("__num_harts_base");
+// Machine software interrupt pending registers, one per hart.
+extern uint32_t volatile MSIP[] asm("__msip_base");
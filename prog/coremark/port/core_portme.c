@@ -17,9 +17,13 @@ Original Author: Shay Gal-on
 */
 
 #include "coremark.h"
+#include "is_simulator.h"
 #include "mtime.h"
 #include "uart.h"
 
+#include <stdbool.h>
+#include <string.h>
+
 #if VALIDATION_RUN
 volatile ee_s32 seed1_volatile = 0x3415;
 volatile ee_s32 seed2_volatile = 0x3415;
@@ -110,7 +114,80 @@ secs_ret time_in_secs(CORE_TICKS ticks) {
     return retval;
 }
 
-ee_u32 default_num_contexts = 1;
+ee_u32 default_num_contexts = MULTITHREAD;
+
+#if MEM_METHOD == MEM_MALLOC
+// Start of the RAM not used by the program.
+extern char __start_free_sram[];
+// Next free byte of RAM.
+static char *heap_next = __start_free_sram;
+
+// Allocate memory for a context; it is never freed.
+void *portable_malloc(ee_size_t size) {
+    void *ptr  = heap_next;
+    heap_next += (size + 7) & ~7;
+    return ptr;
+}
+
+// Memory is only allocated once per run, so it is not reused.
+void portable_free(void *p) {
+    (void)p;
+}
+#endif
+
+#if MULTITHREAD > 1
+void *iterate(void *pres);
+
+// Contexts to run, in the order they were started.
+static core_results *volatile contexts[MULTITHREAD];
+// Number of contexts started by hart 0.
+static volatile ee_u32 num_started;
+// Number of contexts claimed by a hart.
+static volatile ee_u32 num_claimed;
+// Number of contexts finished.
+static volatile ee_u32 num_done;
+
+// Run contexts until all are claimed.
+// Contexts are claimed with LR/SC and finished contexts are counted with AMOADD, so this also tests atomics across harts.
+static void run_contexts(void) {
+    ee_u32 claim = num_claimed;
+    while (claim < MULTITHREAD) {
+        if (__atomic_compare_exchange_n(&num_claimed, &claim, claim + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            iterate(contexts[claim]);
+            __atomic_fetch_add(&num_done, 1, __ATOMIC_RELEASE);
+            claim = num_claimed;
+        }
+    }
+}
+
+/* Function : core_start_parallel
+        Make a context available to the other harts; they start running once
+   all contexts are available.
+*/
+ee_u8 core_start_parallel(core_results *res) {
+    contexts[num_started] = res;
+    __atomic_store_n(&num_started, num_started + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Function : core_stop_parallel
+        Help run the contexts on hart 0, then wait for the other harts to
+   finish theirs.
+*/
+ee_u8 core_stop_parallel(core_results *res) {
+    (void)res;
+    run_contexts();
+    while (num_done < MULTITHREAD) continue;
+    return 0;
+}
+
+// Entrypoint for the harts other than hart 0, called by the start files.
+void hart_main(long hartid) {
+    (void)hartid;
+    while (num_started < MULTITHREAD) continue;
+    run_contexts();
+}
+#endif
 
 /* Function : portable_init
         Target specific initialization code
@@ -120,8 +197,11 @@ void portable_init(core_portable *p, int *argc, char *argv[]) {
 
     (void)argc; // prevent unused warning
     (void)argv; // prevent unused warning
-    print("Waiting for goahead\n");
-    while (!UART0.status.rx_hasdat) continue;
+    // The simulator has no one to press a key, so start right away.
+    if (!IS_SIMULATOR) {
+        print("Waiting for goahead\n");
+        while (!UART0.status.rx_hasdat) continue;
+    }
     print("Starting the CoreMark ok\n");
 
     if (sizeof(ee_ptr_int) != sizeof(ee_u8 *)) {
@@ -140,6 +220,82 @@ void portable_fini(core_portable *p) {
     p->portable_id = 0;
 }
 
+// Print a number for `ee_printf`.
+static int ee_putnum(unsigned long value, unsigned int base, bool upper, bool negative, unsigned int width, char pad) {
+    static char const hextab[] = "0123456789abcdef0123456789ABCDEF";
+    char              buf[12];
+    unsigned int      len = 0;
+    do {
+        buf[len++]  = hextab[(value % base) + upper * 16];
+        value      /= base;
+    } while (value);
+    // The sign counts towards the width but goes before zero padding.
+    unsigned int digits = len + negative;
+    int          count  = digits;
+    if (negative && pad == '0') {
+        putc('-');
+    }
+    for (; width > digits; width--, count++) {
+        putc(pad);
+    }
+    if (negative && pad != '0') {
+        putc('-');
+    }
+    while (len) {
+        putc(buf[--len]);
+    }
+    return count;
+}
+
+// Minimal formatted print for the CoreMark report.
+// Supports the `%c`, `%s`, `%d`, `%i`, `%u`, `%x` and `%X` conversions with optional zero padding and width.
+int ee_printf(char const *fmt, ...) {
+    __builtin_va_list args;
+    __builtin_va_start(args, fmt);
+    int count = 0;
+    while (*fmt) {
+        if (*fmt != '%') {
+            putc(*fmt++);
+            count++;
+            continue;
+        }
+        fmt++;
+        char pad = ' ';
+        if (*fmt == '0') {
+            pad = '0';
+            fmt++;
+        }
+        unsigned int width = 0;
+        while (*fmt >= '0' && *fmt <= '9') {
+            width = width * 10 + *fmt++ - '0';
+        }
+        while (*fmt == 'l') {
+            fmt++;
+        }
+        switch (*fmt) {
+            case 'c': putc(__builtin_va_arg(args, int)); count++; break;
+            case 's': {
+                char const *str = __builtin_va_arg(args, char const *);
+                print(str);
+                count += strlen(str);
+            } break;
+            case 'd':
+            case 'i': {
+                long value  = __builtin_va_arg(args, long);
+                count      += ee_putnum(value < 0 ? -value : value, 10, false, value < 0, width, pad);
+            } break;
+            case 'u': count += ee_putnum(__builtin_va_arg(args, unsigned long), 10, false, false, width, pad); break;
+            case 'x': count += ee_putnum(__builtin_va_arg(args, unsigned long), 16, false, false, width, pad); break;
+            case 'X': count += ee_putnum(__builtin_va_arg(args, unsigned long), 16, true, false, width, pad); break;
+            case '%': putc('%'); count++; break;
+            default: __builtin_va_end(args); return count;
+        }
+        fmt++;
+    }
+    __builtin_va_end(args);
+    return count;
+}
+
 extern void halt();
 
 // ISR required by boa start files.
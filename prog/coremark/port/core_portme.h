@@ -69,7 +69,7 @@ Original Author: Shay Gal-on
 typedef int64_t CORE_TICKS;
 
 #include <print.h>
-#define ee_printf(fmt, ...) print(fmt)
+int ee_printf(char const *fmt, ...);
 
 /* Definitions : COMPILER_VERSION, COMPILER_FLAGS, MEM_LOCATION
         Initialize these strings per platform
@@ -151,6 +151,9 @@ typedef size_t         ee_size_t;
 
         It is valid to have a different implementation of <core_start_parallel>
    and <core_end_parallel> in <core_portme.c>, to fit a particular architecture.
+
+        This port runs one context per hart; building with HARTS=N sets this
+   to N and MEM_METHOD to MEM_MALLOC. Run it on a main with at least N harts.
 */
 #ifndef MULTITHREAD
 #define MULTITHREAD 1
@@ -158,6 +161,9 @@ typedef size_t         ee_size_t;
 #define USE_FORK    0
 #define USE_SOCKET  0
 #endif
+#if MULTITHREAD > 1
+#define PARALLEL_METHOD "Harts"
+#endif
 
 /* Configuration : MAIN_HAS_NOARGC
         Needed if platform does not support getting arguments to main.
@@ -186,7 +192,7 @@ typedef size_t         ee_size_t;
 #endif
 
 /* Variable : default_num_contexts
-        Not used for this simple port, must contain the value 1.
+        Number of contexts to run, equal to MULTITHREAD.
 */
 extern ee_u32 default_num_contexts;
 
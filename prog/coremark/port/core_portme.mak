@@ -22,9 +22,12 @@ OUTFLAG= -o
 # Flag : CC
 #	Use this flag to define compiler to use
 CC = riscv32-unknown-elf-gcc
+# Flag : MARCH
+#	Use this flag to define the ISA to compile for, e.g. rv32imac_zicsr_zifencei_zba_zbb_zbs if the CPU has bit-manipulation
+MARCH ?= rv32imac_zicsr_zifencei
 # Flag : CFLAGS
 #	Use this flag to define compiler options. Note, you can add compiler options from the command line using XCFLAGS="other flags"
-PORT_CFLAGS = -O2 -march=rv32imac_zicsr_zifencei -mabi=ilp32 -DCORE_DEBUG -Dmemory_layout_ram -Wno-builtin-declaration-mismatch -nodefaultlibs -nostdlib -nostartfiles
+PORT_CFLAGS = -O2 -march=$(MARCH) -mabi=ilp32 -Dmemory_layout_ram -Wno-builtin-declaration-mismatch -nodefaultlibs -nostdlib -nostartfiles
 FLAGS_STR = "$(PORT_CFLAGS) $(XCFLAGS) $(XLFLAGS) $(LFLAGS_END)"
 CFLAGS = $(PORT_CFLAGS) -nostdinc -I$(PORT_DIR) -I. -I$(PORT_DIR)/../../common/system -I$(PORT_DIR)/../../common/include -I$(PORT_DIR)/../../common/ld -DFLAGS_STR=\"$(FLAGS_STR)\"
 #Flag : LFLAGS_END
@@ -0,0 +1,22 @@
+
+#include "verilated.h"
+#include "Vcontention.h"
+
+int main(int argc, char **argv) {
+    // Create contexts.
+    VerilatedContext *contextp = new VerilatedContext;
+    contextp->commandArgs(argc, argv);
+    Vcontention      *top      = new Vcontention{contextp};
+
+    // Run until all CPUs are done.
+    for (long i = 0; i <= 10000000 && !contextp->gotFinish(); i++) {
+        top->clk ^= 1;
+        top->eval();
+    }
+    if (!contextp->gotFinish()) {
+        printf("Timed out\n");
+        return 1;
+    }
+
+    return 0;
+}
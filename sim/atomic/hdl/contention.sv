@@ -0,0 +1,270 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+`include "boa_defines.svh"
+
+
+
+// LR/SC contention test: CPUs increment shared counters with LR/SC sequences through a shared memory bus;
+// measures how many increments succeed and how many SCs fail, and checks that no increment was lost.
+// CPU x increments counter x % counters, so with one counter all CPUs contend for the same word,
+// and with as many counters as CPUs they only contend for the reservation controller.
+// Counters are in the low 24 bits of a word; if plain is set, CPUs also increment them with RMW AMOs
+// and write the top byte with plain stores, which an SC must never overwrite, even if the bus serves the store first.
+module contention#(
+    // Reservation controller under test, "1" for boa_amo_ctl_1 or "n" for boa_amo_ctl_n.
+    parameter string  ctl       = "n",
+    // Number of CPUs, at least 2.
+    parameter integer cpus      = 4,
+    // Number of counters.
+    parameter integer counters  = 1,
+    // Number of idle cycles after each increment.
+    parameter integer work      = 2,
+    // Make every fourth operation of a CPU an AMO increment and every fourth a plain store.
+    parameter bit     plain     = 1,
+    // Number of cycles during which CPUs start new increments.
+    parameter integer cycles    = 100000
+)(
+    input logic clk
+);
+    genvar x;
+    
+    logic   rst   = 1;
+    integer cycle = 0;
+    always @(posedge clk) begin
+        rst   <= 0;
+        cycle <= cycle + 1;
+    end
+    // CPUs start new increments.
+    wire    running = cycle < cycles;
+    
+    // Memory that holds the counters and reads in one cycle.
+    // Plain stores only write the top byte; SCs and AMOs write back the top byte they read,
+    // so a full-word write that changes it overwrote a plain store made after its read.
+    logic[31:0] mem_data[64];
+    initial begin
+        integer i;
+        for (i = 0; i < 64; i = i + 1) begin
+            mem_data[i] = 0;
+        end
+    end
+    boa_mem_bus#(8) mem_bus();
+    assign mem_bus.ready = 1;
+    always @(posedge clk) begin
+        integer i;
+        mem_bus.rdata <= mem_data[mem_bus.addr];
+        if (mem_bus.we == 4'b1111 && mem_bus.wdata[31:24] != mem_data[mem_bus.addr][31:24]) begin
+            $error("Write to counter %0d overwrote a plain store", mem_bus.addr);
+        end
+        for (i = 0; i < 4; i = i + 1) begin
+            if (mem_bus.we[i]) begin
+                mem_data[mem_bus.addr][i*8 +: 8] <= mem_bus.wdata[i*8 +: 8];
+            end
+        end
+    end
+    
+    // Shared memory bus.
+    boa_mem_bus#(8) bus[cpus]();
+    logic[7:0] no_caps[cpus];
+    boa_mem_demux#(8, 32, cpus) demux(clk, rst, bus, mem_bus, no_caps);
+    
+    // Reservation controller under test; it watches the CPU buses.
+    boa_amo_bus#(8) amo[cpus]();
+    generate
+        for (x = 0; x < cpus; x = x + 1) begin
+            assign no_caps[x] = 0;
+        end
+        if (ctl == "1") begin: ctl_1
+            boa_amo_ctl_1#(8, cpus, cpus, `BOA_ARBITER_RR, 1) amo_ctl(clk, rst, amo, bus);
+        end else begin: ctl_n
+            boa_amo_ctl_n#(8, cpus, cpus, 2, 1) amo_ctl(clk, rst, amo, bus);
+        end
+    endgenerate
+    
+    // Increment in progress, LR read presented for the first time.
+    localparam st_lr    = 0;
+    // Waiting for the LR read.
+    localparam st_read  = 1;
+    // SC write presented for the first time, if the reservation is still valid.
+    localparam st_sc    = 2;
+    // Waiting for the SC write; it is presented again while the reservation is still valid.
+    localparam st_write = 3;
+    // Idle between increments.
+    localparam st_work  = 4;
+    // No more increments.
+    localparam st_done  = 5;
+    // AMO read presented for the first time.
+    localparam st_amo   = 6;
+    // Waiting for the AMO read; the AMO write is presented when it completes.
+    localparam st_amo_r = 7;
+    // Waiting for the AMO write.
+    localparam st_amo_w = 8;
+    // Plain store presented for the first time.
+    localparam st_store = 9;
+    // Waiting for the plain store.
+    localparam st_str_w = 10;
+    
+    // Number of successful increments per CPU.
+    integer         successes[cpus];
+    // Number of failed SCs per CPU.
+    integer         failures[cpus];
+    // Number of plain stores per CPU.
+    integer         plains[cpus];
+    // CPUs that are done.
+    logic[cpus-1:0] done;
+    
+    generate
+        for (x = 0; x < cpus; x = x + 1) begin: cpu
+            // Increment state.
+            logic[3:0]  state;
+            // Idle cycles left.
+            integer     wait_cnt;
+            // The reservation was valid in every cycle since the LR.
+            logic       resv;
+            // Value read by the LR, or written by the AMO or the plain store.
+            logic[31:0] value;
+            // Number of operations started.
+            integer     ops     = 0;
+            // Statistics.
+            integer     success = 0;
+            integer     fail    = 0;
+            integer     stores  = 0;
+            
+            // The access presented last cycle waits and is presented again.
+            wire        held        = !bus[x].ready;
+            // The SC write is not accepted yet and keeps requesting the reservation, like the MEM stage does.
+            wire        sc_held     = state == st_write && held;
+            // The SC write is presented.
+            wire        sc_ok       = (state == st_sc && resv || sc_held) && amo[x].valid;
+            // The AMO read completes and the AMO write is presented.
+            wire        amo_write   = state == st_amo_r && bus[x].ready;
+            // Kind of the next operation: 0 and 2 are LR/SC sequences, 1 is an AMO and 3 a plain store.
+            wire [1:0]  kind        = plain ? ops + x : 0;
+            assign amo[x].req       = state == st_lr || state == st_read || state == st_sc || sc_held;
+            assign amo[x].addr      = x % counters;
+            assign amo[x].sc        = state == st_sc || sc_held;
+            assign bus[x].re        = state == st_lr || state == st_read && held || state == st_amo || state == st_amo_r && held;
+            assign bus[x].we        = sc_ok || amo_write || state == st_amo_w && held ? 4'b1111
+                                    : state == st_store || state == st_str_w && held ? 4'b1000 : 4'b0000;
+            assign bus[x].addr      = x % counters;
+            assign bus[x].wdata     = amo_write ? bus[x].rdata + 1 : state == st_sc ? value + 1 : value;
+            assign bus[x].blen      = state == st_amo || state == st_amo_r || state == st_amo_w;
+            assign bus[x].bwrap     = 0;
+            assign bus[x].blast     = !(state == st_amo || state == st_amo_r && held);
+            assign successes[x]     = success;
+            assign failures[x]      = fail;
+            assign plains[x]        = stores;
+            assign done[x]          = state == st_done;
+            
+            always @(posedge clk) begin
+                if (rst) begin
+                    // Stagger the first increments.
+                    state       <= st_work;
+                    wait_cnt    <= x;
+                    resv        <= 0;
+                    value       <= 'bx;
+                end else if (state == st_lr) begin
+                    // Make the reservation.
+                    resv        <= amo[x].valid;
+                    state       <= st_read;
+                end else if (state == st_read) begin
+                    // Wait for the LR read.
+                    resv        <= resv && amo[x].valid;
+                    if (bus[x].ready) begin
+                        value       <= bus[x].rdata;
+                        state       <= st_sc;
+                    end
+                end else if (state == st_sc) begin
+                    // Write if the reservation is still valid.
+                    if (sc_ok) begin
+                        value       <= value + 1;
+                        state       <= st_write;
+                    end else begin
+                        fail        <= fail + 1;
+                        state       <= st_work;
+                        wait_cnt    <= work;
+                    end
+                end else if (state == st_write) begin
+                    // Wait for the SC write; it is dropped if the reservation is lost first.
+                    if (bus[x].ready) begin
+                        success     <= success + 1;
+                        state       <= st_work;
+                        wait_cnt    <= work;
+                    end else if (!sc_ok) begin
+                        fail        <= fail + 1;
+                        state       <= st_work;
+                        wait_cnt    <= work;
+                    end
+                end else if (state == st_amo) begin
+                    // AMO read presented.
+                    state       <= st_amo_r;
+                end else if (state == st_amo_r) begin
+                    // Wait for the AMO read.
+                    if (bus[x].ready) begin
+                        value       <= bus[x].rdata + 1;
+                        state       <= st_amo_w;
+                    end
+                end else if (state == st_amo_w) begin
+                    // Wait for the AMO write.
+                    if (bus[x].ready) begin
+                        success     <= success + 1;
+                        state       <= st_work;
+                        wait_cnt    <= work;
+                    end
+                end else if (state == st_store) begin
+                    // Plain store presented.
+                    state       <= st_str_w;
+                end else if (state == st_str_w) begin
+                    // Wait for the plain store.
+                    if (bus[x].ready) begin
+                        stores      <= stores + 1;
+                        state       <= st_work;
+                        wait_cnt    <= work;
+                    end
+                end else if (state == st_work) begin
+                    // Idle until the next operation.
+                    if (!running) begin
+                        state       <= st_done;
+                    end else if (wait_cnt == 0) begin
+                        ops         <= ops + 1;
+                        if (kind == 1) begin
+                            state       <= st_amo;
+                        end else if (kind == 3) begin
+                            value       <= {8'(x * 64 + ops), 24'h00_0000};
+                            state       <= st_store;
+                        end else begin
+                            state       <= st_lr;
+                        end
+                    end else begin
+                        wait_cnt    <= wait_cnt - 1;
+                    end
+                end
+            end
+        end
+    endgenerate
+    
+    always @(posedge clk) begin
+        integer i, total, failed, stored, sum;
+        if (!rst && done == {cpus{1'b1}}) begin
+            total  = 0;
+            failed = 0;
+            stored = 0;
+            sum    = 0;
+            for (i = 0; i < cpus; i = i + 1) begin
+                $display("ctl_%s cpu %0d: %0d increments, %0d failed SCs, %0d plain stores", ctl, i, successes[i], failures[i], plains[i]);
+                total  = total  + successes[i];
+                failed = failed + failures[i];
+                stored = stored + plains[i];
+            end
+            for (i = 0; i < counters; i = i + 1) begin
+                sum    = sum + mem_data[i][23:0];
+            end
+            $display("ctl_%s: %0d increments, %0d failed SCs and %0d plain stores in %0d cycles", ctl, total, failed, stored, cycles);
+            if (sum != total) begin
+                $error("Counters add up to %0d, expected %0d", sum, total);
+            end
+            $finish;
+        end
+    end
+endmodule
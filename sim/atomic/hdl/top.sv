@@ -22,8 +22,10 @@ module top(
     always @(*) begin
         amobus[0].req       = 0;
         amobus[0].addr      = 'bx;
+        amobus[0].sc        = 0;
         amobus[1].req       = 0;
         amobus[1].addr      = 'bx;
+        amobus[1].sc        = 0;
         watchbus[0].we      = 0;
         watchbus[0].addr    = 'bx;
         watchbus[1].we      = 0;
@@ -0,0 +1,154 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+`include "boa_defines.svh"
+
+
+
+// Extmem contention test: two caches share a slow extmem through a demultiplexer;
+// measures how long each takes to complete its accesses and how many cycles it waited for the other, and checks the data read.
+// The fetch cache streams through a region much larger than itself, the data cache does random reads and writes.
+module contention#(
+    // Arbitration method under test, "rr", "static" or "aging".
+    parameter string  arbiter     = "rr",
+    // Whether the demultiplexer picks the next cache one cycle in advance.
+    parameter bit     pipelined   = 0,
+    // Length of the bandwidth cap window in cycles, 0 to disable bandwidth caps.
+    parameter integer bw_window   = 0,
+    // Maximum number of accesses per window by the fetch cache, 0 for no limit.
+    parameter integer bw_cap      = 0,
+    // Whether to transfer lines as bursts.
+    parameter bit     burst       = 0,
+    // Number of cycles extmem takes per access after the first.
+    parameter integer latency     = 3,
+    // Number of accesses per cache.
+    parameter integer accesses    = 4096
+)(
+    input logic clk
+);
+    genvar x;
+    
+    logic rst = 1;
+    always @(posedge clk) rst <= 0;
+    
+    localparam arb = arbiter == "static" ? `BOA_ARBITER_STATIC : arbiter == "aging" ? `BOA_ARBITER_AGING : `BOA_ARBITER_RR;
+    
+    // External memory that takes latency+1 cycles per access, initialised to the word addresses.
+    logic[31:0] xm_mem[16384];
+    initial begin
+        integer i;
+        for (i = 0; i < 16384; i = i + 1) begin
+            xm_mem[i] = i;
+        end
+    end
+    boa_mem_bus#(16) xm_bus();
+    integer xm_wait = 0;
+    always @(posedge clk) begin
+        integer i;
+        if (rst) begin
+            xm_wait      <= 0;
+            xm_bus.ready <= 1;
+        end else if (xm_wait != 0) begin
+            // Access in progress.
+            xm_wait      <= xm_wait - 1;
+            xm_bus.ready <= xm_wait == 1;
+        end else if (xm_bus.re || xm_bus.we != 0) begin
+            // Accept an access.
+            xm_bus.rdata <= xm_mem[xm_bus.addr];
+            for (i = 0; i < 4; i = i + 1) begin
+                if (xm_bus.we[i]) begin
+                    xm_mem[xm_bus.addr][i*8 +: 8] <= xm_bus.wdata[i*8 +: 8];
+                end
+            end
+            xm_wait      <= latency;
+            xm_bus.ready <= latency == 0;
+        end
+    end
+    
+    // Demultiplexer under test; only the fetch cache is capped.
+    boa_mem_bus#(16) bus[2]();
+    boa_mem_bus#(16) xm_buses[2]();
+    logic[7:0] caps[2];
+    assign caps[0] = bw_cap;
+    assign caps[1] = 0;
+    boa_mem_demux#(16, 32, 2, arb, pipelined, bw_window) demux(clk, rst, xm_buses, xm_bus, caps);
+    
+    // Cache 0 fetches and uses the lower half of extmem, cache 1 is writeable and uses the upper half.
+    generate
+        for (x = 0; x < 2; x = x + 1) begin: master
+            // 2 ways of 8 lines of 4 words.
+            logic flushing_r, flushing_w, dirty, miss;
+            boa_cache#(16, 4, 8, 2, x, "rr", 0, 0, 0, 0, burst, 32) cache(
+                clk, rst,
+                0, 0, 0, 0, 0,
+                0, 0,
+                flushing_r, flushing_w, dirty, 0, miss,
+                bus[x], xm_buses[x]
+            );
+            
+            // What the cache should return for this half of extmem; it is updated as writes complete.
+            logic[31:0] model[8192];
+            initial begin
+                integer i;
+                for (i = 0; i < 8192; i = i + 1) begin
+                    model[i] = x * 8192 + i;
+                end
+            end
+            
+            // Access pattern generator.
+            logic       done    = 0;
+            logic       p_re    = 0;
+            logic       p_we    = 0;
+            integer     count   = 0;
+            integer     cycles  = 0;
+            integer     waits   = 0;
+            logic[31:0] lfsr    = 32'hace1_2468 + x;
+            logic[14:2] p_off;
+            logic[31:0] p_wdata;
+            wire [14:2] off     = x == 0 ? count % 2048 : lfsr[14:2];
+            wire        write   = x == 1 && lfsr[0];
+            assign bus[x].re    = !rst && !done && !write;
+            assign bus[x].we    = !rst && !done && write ? 4'b1111 : 4'b0000;
+            assign bus[x].addr  = {1'(x), off};
+            assign bus[x].wdata = lfsr;
+            assign bus[x].blen  = 0;
+            assign bus[x].bwrap = 0;
+            assign bus[x].blast = 1;
+            
+            always @(posedge clk) begin
+                p_re    <= bus[x].re;
+                p_we    <= bus[x].we != 0;
+                p_off   <= off;
+                p_wdata <= bus[x].wdata;
+                if (!rst && !done) begin
+                    cycles  <= cycles + 1;
+                    waits   <= waits + (demux.req[x] && !demux.sel[x]);
+                end
+                if ((p_re || p_we) && bus[x].ready) begin
+                    // Access completed.
+                    if (p_we) begin
+                        model[p_off] <= p_wdata;
+                    end else if (bus[x].rdata != model[p_off]) begin
+                        $error("Read %x from %x, expected %x", bus[x].rdata, {1'(x), p_off, 2'b00}, model[p_off]);
+                    end
+                    lfsr  <= {lfsr[30:0], lfsr[31] ^ lfsr[21] ^ lfsr[1] ^ lfsr[0]};
+                    count <= count + 1;
+                    if (count == accesses - 1) begin
+                        done <= 1;
+                    end
+                end
+            end
+        end
+    endgenerate
+    
+    always @(posedge clk) begin
+        if (master[0].done && master[1].done) begin
+            $display("%s fetch: %0d accesses in %0d cycles, %0d cycles waiting for the other cache",
+                arbiter, accesses, master[0].cycles, master[0].waits);
+            $display("%s data:  %0d accesses in %0d cycles, %0d cycles waiting for the other cache",
+                arbiter, accesses, master[1].cycles, master[1].waits);
+            $finish;
+        end
+    end
+endmodule
@@ -0,0 +1,282 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Cache flush test: runs a fixed sequence of accesses and write-backs, invalidations and precise cache operations,
+// checks the data read and checks extmem against what the write-backs so far should have written.
+// No set is used by more lines than it has ways, so the cache never evicts a line by itself.
+module flush#(
+    // Whether to use a victim buffer.
+    parameter bit     victim_buf  = 0,
+    // Whether to transfer lines as bursts.
+    parameter bit     burst       = 0,
+    // Number of cycles extmem takes per access after the first.
+    parameter integer latency     = 2
+)(
+    input logic clk
+);
+    logic rst = 1;
+    always @(posedge clk) rst <= 0;
+    
+    // External memory that takes latency+1 cycles per access, initialised to the word addresses.
+    // Writes take effect when they complete, so a write-back that is still in progress is not visible yet.
+    logic[31:0] xm_mem[16384];
+    initial begin
+        integer i;
+        for (i = 0; i < 16384; i = i + 1) begin
+            xm_mem[i] = i;
+        end
+    end
+    boa_mem_bus#(16) xm_bus();
+    integer     xm_wait = 0;
+    logic[3:0]  xm_we;
+    logic[15:2] xm_addr;
+    logic[31:0] xm_wdata;
+    always @(posedge clk) begin
+        integer i;
+        if (rst) begin
+            xm_wait      <= 0;
+            xm_bus.ready <= 1;
+        end else if (xm_wait != 0) begin
+            // Access in progress; a write takes effect as it completes.
+            xm_wait      <= xm_wait - 1;
+            xm_bus.ready <= xm_wait == 1;
+            for (i = 0; i < 4; i = i + 1) begin
+                if (xm_wait == 1 && xm_we[i]) begin
+                    xm_mem[xm_addr][i*8 +: 8] <= xm_wdata[i*8 +: 8];
+                end
+            end
+        end else if (xm_bus.re || xm_bus.we != 0) begin
+            // Accept an access.
+            xm_bus.rdata <= xm_mem[xm_bus.addr];
+            for (i = 0; i < 4; i = i + 1) begin
+                if (latency == 0 && xm_bus.we[i]) begin
+                    xm_mem[xm_bus.addr][i*8 +: 8] <= xm_bus.wdata[i*8 +: 8];
+                end
+            end
+            xm_we        <= xm_bus.we;
+            xm_addr      <= xm_bus.addr;
+            xm_wdata     <= xm_bus.wdata;
+            xm_wait      <= latency;
+            xm_bus.ready <= latency == 0;
+        end
+    end
+    
+    // 2 ways of 4 lines of 4 words; byte address bits 5:4 select the line.
+    boa_mem_bus#(16) bus();
+    logic flush_r, flush_w, pi_en, flushing_r, flushing_w, dirty, miss;
+    logic[15:2] pi_addr;
+    boa_cache#(16, 4, 4, 2, 1, "rr", 0, 0, victim_buf, 0, burst, 32) cache(
+        clk, rst,
+        flush_r, flush_w, pi_en, pi_addr, 0,
+        0, 0,
+        flushing_r, flushing_w, dirty, 0, miss,
+        bus, xm_bus
+    );
+    
+    // Read a word and check it.
+    localparam op_read  = 0;
+    // Write a word.
+    localparam op_write = 1;
+    // Write back the entire cache.
+    localparam op_wb    = 2;
+    // Write back and invalidate the entire cache.
+    localparam op_flush = 3;
+    // Write back the line containing the address.
+    localparam op_clean = 4;
+    // Discard the line containing the address.
+    localparam op_inval = 5;
+    // Write back and discard the line containing the address.
+    localparam op_cbofl = 6;
+    // Check extmem.
+    localparam op_check = 7;
+    
+    // Operation sequence.
+    integer     ops;
+    logic[2:0]  op_kind[64];
+    logic[15:2] op_addr[64];
+    logic[31:0] op_data[64];
+    task automatic add(input logic[2:0] kind, input logic[15:0] addr, input logic[31:0] data);
+        op_kind[ops] = kind;
+        op_addr[ops] = addr[15:2];
+        op_data[ops] = data;
+        ops          = ops + 1;
+    endtask
+    initial begin
+        ops = 0;
+        // Write-back of line 0 right after the reset invalidation, which must not mark the invalid ways valid.
+        add(op_write, 16'h0000, 32'ha000_0000);
+        add(op_wb,    0,        0);
+        add(op_check, 0,        0);
+        add(op_read,  16'h0010, 0);
+        add(op_read,  16'h0020, 0);
+        add(op_read,  16'h0030, 0);
+        add(op_read,  16'h0004, 0);
+        // Write-back to the address of the dirty line, not to that of the last access.
+        add(op_write, 16'hffc4, 32'ha000_0001);
+        add(op_read,  16'h0110, 0);
+        add(op_wb,    0,        0);
+        add(op_check, 0,        0);
+        // Precise operations act on the way that holds the line, with that way's dirty bit.
+        add(op_write, 16'h0228, 32'ha000_0002);
+        add(op_clean, 16'h0020, 0);
+        add(op_check, 0,        0);
+        add(op_clean, 16'h0228, 0);
+        add(op_check, 0,        0);
+        add(op_write, 16'h0020, 32'ha000_0003);
+        add(op_inval, 16'h0228, 0);
+        add(op_read,  16'h0228, 0);
+        add(op_cbofl, 16'h0020, 0);
+        add(op_check, 0,        0);
+        add(op_read,  16'h0020, 0);
+        // An invalidation discards writes.
+        add(op_write, 16'h0030, 32'ha000_0004);
+        add(op_inval, 16'h0030, 0);
+        add(op_read,  16'h0030, 0);
+        // Write back every way of every line; extmem is complete when flushing_w falls.
+        add(op_write, 16'h0000, 32'ha000_0005);
+        add(op_write, 16'hffc8, 32'ha000_0006);
+        add(op_write, 16'h0014, 32'ha000_0007);
+        add(op_write, 16'h0118, 32'ha000_0008);
+        add(op_write, 16'h002c, 32'ha000_0009);
+        add(op_write, 16'h0220, 32'ha000_000a);
+        add(op_write, 16'h0034, 32'ha000_000b);
+        add(op_write, 16'h0178, 32'ha000_000c);
+        add(op_wb,    0,        0);
+        add(op_check, 0,        0);
+        // Write back and invalidate, then read back from extmem.
+        add(op_write, 16'h0004, 32'ha000_000d);
+        add(op_write, 16'h011c, 32'ha000_000e);
+        add(op_write, 16'h0178, 32'ha000_000f);
+        add(op_flush, 0,        0);
+        add(op_check, 0,        0);
+        add(op_read,  16'h0004, 0);
+        add(op_read,  16'h011c, 0);
+        add(op_read,  16'h0178, 0);
+    end
+    
+    // What the cache should return; it is updated as writes complete.
+    logic[31:0] model   [16384];
+    // What extmem should contain after the write-backs so far.
+    logic[31:0] xm_model[16384];
+    initial begin
+        integer i;
+        for (i = 0; i < 16384; i = i + 1) begin
+            model[i]    = i;
+            xm_model[i] = i;
+        end
+    end
+    
+    // Waiting for the reset invalidation.
+    localparam st_boot  = 0;
+    // Start the next operation.
+    localparam st_next  = 1;
+    // Access presented for the first time.
+    localparam st_acc   = 2;
+    // Waiting for the access.
+    localparam st_accw  = 3;
+    // Cache operation requested.
+    localparam st_fl    = 4;
+    // Waiting for the cache operation.
+    localparam st_flw   = 5;
+    
+    // Sequencer state.
+    logic[2:0]  state   = st_boot;
+    // Current operation.
+    integer     idx     = 0;
+    // Cycles taken by the current cache operation.
+    integer     cycles  = 0;
+    // Kind of the current operation.
+    wire [2:0]  kind    = op_kind[idx];
+    // First word of the line the current operation applies to.
+    wire [15:2] line    = {op_addr[idx][15:4], 2'b00};
+    // The access is presented on the cache bus.
+    wire        present = state == st_acc || state == st_accw && !bus.ready;
+    assign bus.re    = present && kind == op_read;
+    assign bus.we    = present && kind == op_write ? 4'b1111 : 4'b0000;
+    assign bus.addr  = op_addr[idx];
+    assign bus.wdata = op_data[idx];
+    assign bus.blen  = 0;
+    assign bus.bwrap = 0;
+    assign bus.blast = 1;
+    assign flush_w   = state == st_fl && (kind == op_wb || kind == op_flush || kind == op_clean || kind == op_cbofl);
+    assign flush_r   = state == st_fl && (kind == op_flush || kind == op_inval || kind == op_cbofl);
+    assign pi_en     = state == st_fl && (kind == op_clean || kind == op_inval || kind == op_cbofl);
+    assign pi_addr   = op_addr[idx];
+    
+    always @(posedge clk) begin
+        integer i;
+        if (rst) begin
+            state   <= st_boot;
+        end else if (state == st_boot) begin
+            // Wait for the reset invalidation.
+            if (!flushing_r) begin
+                state   <= st_next;
+            end
+        end else if (state == st_next) begin
+            // Start the next operation.
+            if (idx == ops) begin
+                $display("flush: %0d operations done", ops);
+                $finish;
+            end else if (kind == op_read || kind == op_write) begin
+                state   <= st_acc;
+            end else if (kind == op_check) begin
+                for (i = 0; i < 16384; i = i + 1) begin
+                    if (xm_mem[i] != xm_model[i]) begin
+                        $error("Operation %0d: extmem has %x at %x, expected %x", idx, xm_mem[i], i << 2, xm_model[i]);
+                    end
+                end
+                idx     <= idx + 1;
+            end else begin
+                state   <= st_fl;
+            end
+        end else if (state == st_acc) begin
+            // Access presented.
+            state   <= st_accw;
+        end else if (state == st_accw) begin
+            // Wait for the access.
+            if (bus.ready) begin
+                if (kind == op_write) begin
+                    model[op_addr[idx]] <= op_data[idx];
+                end else if (bus.rdata != model[op_addr[idx]]) begin
+                    $error("Operation %0d: read %x from %x, expected %x", idx, bus.rdata, op_addr[idx] << 2, model[op_addr[idx]]);
+                end
+                state   <= st_next;
+                idx     <= idx + 1;
+            end
+        end else if (state == st_fl) begin
+            // Cache operation requested; flushing_r and flushing_w are valid from the next cycle.
+            state   <= st_flw;
+            cycles  <= 1;
+        end else if (state == st_flw) begin
+            // Wait for the cache operation.
+            cycles  <= cycles + 1;
+            if (!flushing_r && !flushing_w) begin
+                if (kind == op_wb || kind == op_flush) begin
+                    for (i = 0; i < 16384; i = i + 1) begin
+                        xm_model[i] <= model[i];
+                    end
+                    if (dirty) begin
+                        $error("Operation %0d: cache still dirty after a write-back", idx);
+                    end
+                end else if (kind == op_clean || kind == op_cbofl) begin
+                    for (i = 0; i < 4; i = i + 1) begin
+                        xm_model[line + i] <= model[line + i];
+                    end
+                end else begin
+                    for (i = 0; i < 4; i = i + 1) begin
+                        model[line + i] <= xm_model[line + i];
+                    end
+                end
+                state   <= st_next;
+                idx     <= idx + 1;
+            end else if (cycles > 1000) begin
+                $error("Operation %0d: cache operation did not complete", idx);
+                $finish;
+            end
+        end
+    end
+endmodule
@@ -0,0 +1,182 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Cache stress test: measures the hit rate and cycle count for a few access patterns and checks the data read.
+module stress#(
+    // Replacement policy under test.
+    parameter string  replacement = "rr",
+    // Whether to fill lines critical word first.
+    parameter bit     cwf         = 0,
+    // Number of miss status holding registers.
+    parameter integer mshrs       = 0,
+    // Whether to use a victim buffer.
+    parameter bit     victim_buf  = 0,
+    // Whether to transfer lines as bursts.
+    parameter bit     burst       = 0,
+    // Extmem data bus size, 32 or 64.
+    parameter integer xm_dlen     = 32,
+    // Number of accesses per pattern.
+    parameter integer accesses    = 4096
+)(
+    input logic clk
+);
+    logic rst = 1;
+    always @(posedge clk) rst <= 0;
+    
+    // External memory with a latency of one cycle, initialised to the word addresses.
+    // The model is what the cache should return; it is updated as writes complete.
+    localparam xw = xm_dlen / 32;
+    logic[31:0] xm_mem[16384];
+    logic[31:0] model [16384];
+    initial begin
+        integer i;
+        for (i = 0; i < 16384; i = i + 1) begin
+            xm_mem[i] = i;
+            model[i]  = i;
+        end
+    end
+    boa_mem_bus#(16, xm_dlen) xm_bus();
+    assign xm_bus.ready = 1;
+    always @(posedge clk) begin
+        integer i;
+        if ((xm_bus.re || xm_bus.we != 0) && xm_bus.addr % xw != 0) begin
+            $error("Misaligned extmem access at %x", xm_bus.addr << 2);
+        end
+        for (i = 0; i < xw; i = i + 1) begin
+            xm_bus.rdata[32*i +: 32] <= xm_mem[xm_bus.addr + i];
+            if (xm_bus.we[4*i +: 4] != 0) begin
+                xm_mem[xm_bus.addr + i] <= xm_bus.wdata[32*i +: 32];
+            end
+        end
+    end
+    
+    // Burst checker: beats follow each other without gaps at incrementing or wrapping addresses,
+    // and only the last one is flagged.
+    integer     xb_left = 0;
+    logic[15:2] xb_next;
+    wire [15:2] xb_mask = (xm_bus.blen + 1) * xw - 1;
+    always @(posedge clk) begin
+        integer left;
+        if (xm_bus.re || xm_bus.we != 0) begin
+            if (xb_left != 0 && xm_bus.addr != xb_next) begin
+                $error("Burst beat at %x, expected %x", xm_bus.addr << 2, xb_next << 2);
+            end
+            if (xm_bus.blen != 0) begin
+                left = xb_left != 0 ? xb_left - 1 : xm_bus.blen;
+                if (xm_bus.blast != (left == 0)) begin
+                    $error("Burst beat at %x has blast=%0d with %0d beats left", xm_bus.addr << 2, xm_bus.blast, left);
+                end
+                xb_left <= left;
+                xb_next <= xm_bus.bwrap ? (xm_bus.addr & ~xb_mask) | ((xm_bus.addr + xw) & xb_mask) : xm_bus.addr + xw;
+            end else if (xb_left != 0) begin
+                $error("Single access at %x during a burst", xm_bus.addr << 2);
+            end
+        end else if (xb_left != 0) begin
+            $error("Gap in a burst before %x", xb_next << 2);
+        end
+    end
+    
+    // 4 ways of 8 lines of 4 words; one set spans 128 bytes.
+    localparam set_stride = 128 / 4;
+    boa_mem_bus#(16) bus();
+    logic flush_r, flush_w, pi_en, prefetch, flushing_r, flushing_w, dirty, miss;
+    boa_cache#(16, 4, 8, 4, 1, replacement, cwf, mshrs, victim_buf, 0, burst, xm_dlen) cache(
+        clk, rst,
+        flush_r, flush_w, pi_en, addr, prefetch,
+        0, 0,
+        flushing_r, flushing_w, dirty, 0, miss,
+        bus, xm_bus
+    );
+    
+    // Access pattern generator.
+    // Pattern 0: a hot line interleaved with a stream of lines in the same set.
+    // Pattern 1: a loop over ways+1 lines in the same set.
+    // Pattern 2: random accesses skewed towards a small hot region.
+    // Pattern 3: random reads and writes over 8 times the cache size, which evicts dirty lines.
+    // Pattern 4: pattern 3 with a write-back, clean, flush or prefetch in place of every 64th access.
+    // Pattern 5: write back the entire cache and check extmem against the model.
+    logic       op_want = 0;
+    logic       p_re    = 0;
+    logic       p_we    = 0;
+    integer     pattern = 0;
+    integer     count   = 0;
+    integer     misses  = 0;
+    integer     cycles  = 0;
+    logic[31:0] lfsr    = 32'hace1_2468;
+    logic[15:2] addr;
+    logic[15:2] p_addr;
+    logic[31:0] p_wdata;
+    always @(*) begin
+        case (pattern)
+            default: addr = count[0] ? ((count >> 1) % 255 + 1) * set_stride : 0;
+            1:       addr = (count % 5) * set_stride + 1;
+            2:       addr = lfsr[2:0] != 0 ? lfsr[9:3] : lfsr[23:10];
+            3, 4:    addr = lfsr[11:2];
+        endcase
+    end
+    wire write = pattern >= 3 && lfsr[0];
+    // A cache operation is issued once the previous access has completed.
+    wire op    = op_want && (!(p_re || p_we) || bus.ready);
+    wire idle  = op || pattern == 5;
+    assign bus.re    = !rst && !idle && !write;
+    assign bus.we    = !rst && !idle && write ? 4'b1111 : 4'b0000;
+    assign bus.addr  = addr;
+    assign bus.wdata = lfsr;
+    assign bus.blen  = 0;
+    assign bus.bwrap = 0;
+    assign bus.blast = 1;
+    
+    // Cache operations; the precise ones and the prefetch use the current address.
+    assign flush_w   = (op && count[7:6] != 3) || (pattern == 5 && cycles == 0);
+    assign flush_r   = op && count[7:6] == 2;
+    assign pi_en     = op && count[7:6] != 0;
+    assign prefetch  = op && count[7:6] == 3;
+    
+    always @(posedge clk) begin
+        integer i;
+        p_re    <= bus.re;
+        p_we    <= bus.we != 0;
+        p_addr  <= addr;
+        p_wdata <= bus.wdata;
+        misses  <= misses + miss;
+        cycles  <= cycles + 1;
+        if (op) begin
+            op_want <= 0;
+        end
+        if (pattern == 5 && cycles > 1 && !flushing_w) begin
+            // Write-back completed.
+            for (i = 0; i < 16384; i = i + 1) begin
+                if (xm_mem[i] != model[i]) begin
+                    $error("Extmem has %x at %x, expected %x", xm_mem[i], i << 2, model[i]);
+                end
+            end
+            $display("%s write-back: %0d cycles", replacement, cycles);
+            $finish;
+        end
+        if ((p_re || p_we) && bus.ready) begin
+            // Access completed.
+            if (p_we) begin
+                model[p_addr] <= p_wdata;
+            end else if (bus.rdata != model[p_addr]) begin
+                $error("Read %x from %x, expected %x", bus.rdata, p_addr << 2, model[p_addr]);
+            end
+            lfsr  <= {lfsr[30:0], lfsr[31] ^ lfsr[21] ^ lfsr[1] ^ lfsr[0]};
+            count <= count + 1;
+            if (pattern == 4 && count[5:0] == 63) begin
+                op_want <= 1;
+            end
+            if (count == accesses - 1) begin
+                $display("%s pattern %0d: %0d / %0d hits, %0d cycles", replacement, pattern, accesses - misses - miss, accesses, cycles + 1);
+                pattern <= pattern + 1;
+                count   <= 0;
+                misses  <= 0;
+                cycles  <= 0;
+                op_want <= 0;
+            end
+        end
+    end
+endmodule
@@ -23,13 +23,18 @@ module top(
     end
     
     boa_mem_bus#(16) bus();
-    logic flush_r, flush_w, pi_en;
+    logic flush_r, flush_w, pi_en, flushing_r, flushing_w, dirty, miss;
     logic[15:2] pi_addr;
     boa_cache#(16, 4, 4, 2) cache(
         clk, rst,
-        flush_r, flush_w, pi_en, pi_addr,
+        flush_r, flush_w, pi_en, pi_addr, 0,
+        0, 0,
+        flushing_r, flushing_w, dirty, 0, miss,
         bus, xm_bus
     );
+    assign bus.blen  = 0;
+    assign bus.bwrap = 0;
+    assign bus.blast = 1;
     
     always @(*) begin
         xm_bus.ready = 1;
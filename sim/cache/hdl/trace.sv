@@ -0,0 +1,186 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Cache trace test: replays the fetches and data accesses recorded from CoreMark by `make -C ../coremark trace`
+// through an instruction and a data cache shaped like those of main, measures the hit rate and cycle count and checks the data read.
+// Each cache replays its accesses back to back; ROM, RAM and the first 64K of extmem map to separate 64K regions.
+module trace#(
+    // Replacement policy under test.
+    parameter string  replacement = "rr",
+    // Whether to fill lines critical word first.
+    parameter bit     cwf         = 0,
+    // Number of miss status holding registers.
+    parameter integer mshrs       = 0,
+    // Whether the data cache uses a victim buffer.
+    parameter bit     victim_buf  = 0,
+    // Whether to transfer lines as bursts.
+    parameter bit     burst       = 0,
+    // Extmem data bus size, 32 or 64.
+    parameter integer xm_dlen     = 32,
+    // Number of ways.
+    parameter integer ways        = 2,
+    // Number of lines per way.
+    parameter integer lines       = 32,
+    // Number of 4-byte words per line.
+    parameter integer line_size   = 16,
+    // Trace file to replay.
+    parameter string  trace_file  = "../coremark/obj_dir/trace.txt"
+)(
+    input logic clk
+);
+    genvar x;
+    
+    logic rst = 1;
+    always @(posedge clk) rst <= 0;
+    
+    // Ports that have replayed all of their accesses.
+    logic[1:0]  done;
+    // Number of accesses per port.
+    integer     accesses[2];
+    // Number of cache misses per port.
+    integer     misses[2];
+    // Number of cycles per port.
+    integer     cycles[2];
+    
+    generate
+        for (x = 0; x < 2; x = x + 1) begin: port
+            // External memory with a latency of one cycle, initialised to the word addresses.
+            // The model is what the cache should return; it is updated as writes complete.
+            localparam xw = xm_dlen / 32;
+            logic[31:0] xm_mem[65536];
+            logic[31:0] model [65536];
+            initial begin
+                integer i;
+                for (i = 0; i < 65536; i = i + 1) begin
+                    xm_mem[i] = i;
+                    model[i]  = i;
+                end
+            end
+            boa_mem_bus#(18, xm_dlen) xm_bus();
+            assign xm_bus.ready = 1;
+            always @(posedge clk) begin
+                integer i;
+                for (i = 0; i < xw; i = i + 1) begin
+                    xm_bus.rdata[32*i +: 32] <= xm_mem[xm_bus.addr + i];
+                    if (xm_bus.we[4*i +: 4] != 0) begin
+                        xm_mem[xm_bus.addr + i] <= xm_bus.wdata[32*i +: 32];
+                    end
+                end
+            end
+            
+            // Port 0 is the instruction cache, port 1 the data cache.
+            boa_mem_bus#(18) bus();
+            logic flushing_r, flushing_w, dirty, miss;
+            boa_cache#(18, line_size, lines, ways, x, replacement, cwf, mshrs, x && victim_buf, 0, burst, xm_dlen) cache(
+                clk, rst,
+                0, 0, 0, 0, 0,
+                0, 0,
+                flushing_r, flushing_w, dirty, 0, miss,
+                bus, xm_bus
+            );
+            
+            // Trace file.
+            integer     fd;
+            // Next access from the trace is valid.
+            logic       n_valid;
+            // Next access address.
+            logic[17:2] n_addr;
+            // Next access write enables.
+            logic[3:0]  n_we;
+            // An access was presented last cycle.
+            logic       p_valid = 0;
+            // Access presented last cycle.
+            logic[17:2] p_addr;
+            logic[3:0]  p_we;
+            logic[31:0] p_wdata;
+            // Data written by the next write.
+            logic[31:0] wdata   = 32'hace1_2468;
+            // The access presented last cycle is presented again.
+            wire        hold    = p_valid && !bus.ready;
+            
+            // Read the next access for this port from the trace.
+            task automatic read_next();
+                integer     r;
+                logic[7:0]  kind;
+                logic[31:0] addr;
+                logic[3:0]  we;
+                n_valid = 0;
+                while (!n_valid && !$feof(fd)) begin
+                    r = $fscanf(fd, " %c %h %h", kind, addr, we);
+                    if (r == 3 && (x == 0 ? kind == "I" : kind != "I")) begin
+                        n_valid = 1;
+                        n_addr  = {addr[31], addr[28], addr[15:2]};
+                        n_we    = we;
+                    end
+                end
+            endtask
+            
+            initial begin
+                fd = $fopen(trace_file, "r");
+                if (!fd) begin
+                    $display("Error opening %s", trace_file);
+                    $finish;
+                end
+                read_next();
+            end
+            
+            assign bus.re    = !rst && (hold ? p_we == 0 : n_valid && n_we == 0);
+            assign bus.we    = rst ? 0 : hold ? p_we : n_valid ? n_we : 0;
+            assign bus.addr  = hold ? p_addr : n_addr;
+            assign bus.wdata = hold ? p_wdata : wdata;
+            assign bus.blen  = 0;
+            assign bus.bwrap = 0;
+            assign bus.blast = 1;
+            assign done[x]   = !n_valid && !p_valid;
+            
+            always @(posedge clk) begin
+                integer i;
+                if (p_valid && bus.ready) begin
+                    // Access completed.
+                    for (i = 0; i < 4; i = i + 1) begin
+                        if (p_we[i]) begin
+                            model[p_addr][i*8 +: 8] <= p_wdata[i*8 +: 8];
+                        end
+                    end
+                    if (p_we == 0 && bus.rdata != model[p_addr]) begin
+                        $error("Read %x from %x, expected %x", bus.rdata, p_addr << 2, model[p_addr]);
+                    end
+                    accesses[x] <= accesses[x] + 1;
+                end
+                if (!rst && !done[x]) begin
+                    misses[x]   <= misses[x] + miss;
+                    cycles[x]   <= cycles[x] + 1;
+                end
+                if (rst) begin
+                    accesses[x] <= 0;
+                    misses[x]   <= 0;
+                    cycles[x]   <= 0;
+                end else if (!hold) begin
+                    // Present the next access.
+                    p_valid     <= n_valid;
+                    p_addr      <= n_addr;
+                    p_we        <= n_we;
+                    p_wdata     <= wdata;
+                    if (n_valid && n_we != 0) begin
+                        wdata       <= {wdata[30:0], wdata[31] ^ wdata[21] ^ wdata[1] ^ wdata[0]};
+                    end
+                    if (n_valid) begin
+                        read_next();
+                    end
+                end
+            end
+        end
+    endgenerate
+    
+    always @(posedge clk) begin
+        if (!rst && done == 2'b11) begin
+            $display("%s coremark fetch: %0d / %0d hits, %0d cycles", replacement, accesses[0] - misses[0], accesses[0], cycles[0]);
+            $display("%s coremark data:  %0d / %0d hits, %0d cycles", replacement, accesses[1] - misses[1], accesses[1], cycles[1]);
+            $finish;
+        end
+    end
+endmodule
@@ -0,0 +1,22 @@
+
+#include "verilated.h"
+#include "Vtrace.h"
+
+int main(int argc, char **argv) {
+    // Create contexts.
+    VerilatedContext *contextp = new VerilatedContext;
+    contextp->commandArgs(argc, argv);
+    Vtrace          *top      = new Vtrace{contextp};
+
+    // Run until all accesses are replayed.
+    for (long i = 0; i <= 200000000 && !contextp->gotFinish(); i++) {
+        top->clk ^= 1;
+        top->eval();
+    }
+    if (!contextp->gotFinish()) {
+        printf("Timed out\n");
+        return 1;
+    }
+
+    return 0;
+}
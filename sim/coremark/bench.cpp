@@ -0,0 +1,144 @@
+#include "verilated.h"
+#include "Vtop.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+// UART clock divider value.
+#define UART_CLK_DIV 4
+// Default maximum number of CPU cycles to simulate.
+#define MAX_CYCLES   200000000
+
+// Clock divider value for DUT TX pin.
+int               tx_div = -1;
+// Pending bits to receive from DUT TX pin.
+std::vector<bool> tx_pending;
+// Current line of UART output.
+std::string       line;
+
+// Number of CRC errors reported.
+int      crc_errors;
+// Whether the seed CRC was reported.
+bool     has_seedcrc;
+// Number of iterations reported.
+uint64_t iterations;
+// Number of timer ticks, which are CPU cycles, reported.
+uint64_t ticks;
+
+// Parse a `Name : value` line of the CoreMark report.
+bool parse_field(char const *name, uint64_t *out) {
+    if (strncmp(line.c_str(), name, strlen(name))) {
+        return false;
+    }
+    char const *colon = strchr(line.c_str(), ':');
+    if (!colon) {
+        return false;
+    }
+    *out = strtoull(colon + 1, NULL, 0);
+    return true;
+}
+
+// Handle a complete line of UART output.
+void uart_handle_line() {
+    if (strstr(line.c_str(), "ERROR!") && strstr(line.c_str(), "crc")) {
+        crc_errors++;
+    }
+    if (strstr(line.c_str(), "seedcrc")) {
+        has_seedcrc = true;
+    }
+    parse_field("Iterations ", &iterations);
+    parse_field("Total ticks", &ticks);
+    line.clear();
+}
+
+// Receive a byte from DUT RX pin.
+void uart_handle_tx_pending() {
+    if (tx_pending.back()) {
+        uint8_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value <<= 1;
+            value  |= tx_pending[7 - i];
+        }
+        fputc(value, stdout);
+        fflush(stdout);
+        if (value == '\n') {
+            uart_handle_line();
+        } else if (value != '\r') {
+            line.push_back(value);
+        }
+    }
+    tx_pending.clear();
+}
+
+int main(int argc, char **argv) {
+    char const *run_name = argc > 1 ? argv[1] : "coremark";
+
+    // Check cycle limit.
+    uint64_t    max_cycles = MAX_CYCLES;
+    char const *max_str    = getenv("MAX_CYCLES");
+    if (max_str && *max_str) {
+        max_cycles = strtoull(max_str, NULL, 0);
+    }
+
+    // Create contexts.
+    VerilatedContext *contextp = new VerilatedContext;
+    contextp->commandArgs(argc, argv);
+    Vtop *top = new Vtop{contextp};
+
+    // Run until the CPU powers off or the cycle limit is reached.
+    top->rx         = 1;
+    uint64_t cycles = 0;
+    while (!contextp->gotFinish() && cycles < max_cycles) {
+        // Run a simulation tick.
+        top->eval();
+        top->clk ^= 1;
+
+        // UART logic.
+        if (top->clk) {
+            cycles++;
+            // Receive a bit from RUT TX pin.
+            if (tx_div == -1) {
+                if (!top->tx) {
+                    tx_div = 0;
+                }
+            } else {
+                tx_div = (tx_div + 1) % UART_CLK_DIV;
+                if (tx_div == 0) {
+                    tx_pending.push_back(top->tx);
+                    if (tx_pending.size() == 9) {
+                        uart_handle_tx_pending();
+                        tx_div = -1;
+                    }
+                }
+            }
+        }
+    }
+    if (line.size()) {
+        uart_handle_line();
+    }
+
+    // Check the results.
+    printf("\n");
+    if (!contextp->gotFinish()) {
+        printf("%s: FAIL, timed out after %" PRIu64 " cycles\n", run_name, cycles);
+        return 1;
+    } else if (!has_seedcrc || !iterations || !ticks) {
+        printf("%s: FAIL, incomplete CoreMark report\n", run_name);
+        return 1;
+    } else if (crc_errors) {
+        printf("%s: FAIL, %d CRC mismatch(es)\n", run_name, crc_errors);
+        return 1;
+    }
+
+    // The timer runs at the CPU clock, so CoreMark/MHz is iterations per million cycles.
+    uint64_t milli = iterations * 1000000000llu / ticks;
+    printf("%s: PASS, %" PRIu64 " iterations in %" PRIu64 " cycles\n", run_name, iterations, ticks);
+    printf("%s: CoreMark/MHz %" PRIu64 ".%03" PRIu64 "\n", run_name, milli / 1000, milli % 1000);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+module top#(
+    // Number of harts, each running a CoreMark context.
+    parameter integer harts = 1,
+    // Record the memory accesses of hart 0 in obj_dir/trace.txt for the cache trace test.
+    parameter bit     trace = 0
+)(
+    input  logic clk,
+    output logic tx,
+    input  logic rx
+);
+    `include "boa_fileio.svh"
+    logic rst = 1;
+    logic rtc_clk;
+    // The RTC runs at the CPU clock so that mtime counts exact cycles.
+    param_clk_div#(1, 1) rtc_div(clk, rtc_clk);
+    
+    localparam xm_alen = 19;
+    
+    // Bus definitions.
+    logic[31:0]  gpio_out;
+    logic[31:0]  gpio_oe;
+    logic[31:0]  gpio_in;
+    assign gpio_in = gpio_out;
+    logic[31:0] randomness = 0;
+    boa_mem_bus#(12) xmp_bus();
+    boa_mem_bus#(xm_alen) extrom_bus();
+    boa_mem_bus#(xm_alen) extram_bus();
+    pmu_bus pmb();
+    
+    // Fence signals.
+    logic fence_rl, fence_aq, fence_i;
+    
+    // Main microcontroller device, booting straight into the CoreMark image in RAM.
+    main#(
+        .ram_file({boa_parentdir(`__FILE__), "/../obj_dir/ram.mem"}),
+        .entrypoint(32'h5000_0000),
+        .uart_buf(65536),
+        .uart_div(4),
+        .is_simulator(1),
+        .harts(harts),
+        .extrom_alen(xm_alen),
+        .extram_alen(xm_alen)
+    ) main (
+        clk, rtc_clk, rst,
+        tx, rx,
+        gpio_out, gpio_oe, gpio_in,
+        randomness,
+        xmp_bus, extrom_bus, extram_bus,
+        fence_rl, fence_aq, fence_i,
+        pmb
+    );
+    
+    // Additional peripherals.
+    // Extmem size device.
+    boa_peri_readable#('h600) xm_size(clk, rst, xmp_bus, 32'b1 << xm_alen);
+    
+    // Simulated external SRAM.
+    logic               sram_re;
+    logic               sram_we;
+    logic[xm_alen-1:0]  sram_addr;
+    logic[7:0]          sram_wdata;
+    logic[7:0]          sram_rdata;
+    raw_sram#(xm_alen) sram(clk, sram_re, sram_we, sram_addr, sram_wdata, sram_rdata);
+    boa_extmem_sram#(xm_alen) sram_ctl(clk, rst, extram_bus, sram_re, sram_we, sram_addr, sram_wdata, sram_rdata);
+    
+    // External ROM stub.
+    assign extrom_bus.ready = 1;
+    assign extrom_bus.rdata = 0;
+    
+    // Memory access trace: one line per completed access of hart 0 to the ROM, RAM or extmem,
+    // "I" for fetches, "R" for reads and "W" for writes, followed by the byte address and the write enables.
+    generate if (trace) begin: tracer
+        integer     fd;
+        logic       p_ire;
+        logic[31:2] p_iaddr;
+        logic       p_dre;
+        logic[3:0]  p_dwe;
+        logic[31:2] p_daddr;
+        initial begin
+            fd = $fopen({boa_parentdir(`__FILE__), "/../obj_dir/trace.txt"}, "w");
+        end
+        always @(posedge clk) begin
+            p_ire   <= !rst && main.cpu_ibus[0].re;
+            p_iaddr <= main.cpu_ibus[0].addr;
+            p_dre   <= !rst && main.cpu_dbus[0].re;
+            p_dwe   <= rst ? 0 : main.cpu_dbus[0].we;
+            p_daddr <= main.cpu_dbus[0].addr;
+            if (p_ire && main.cpu_ibus[0].ready && (p_iaddr[31:28] == 4 || p_iaddr[31:28] == 5 || p_iaddr[31])) begin
+                $fdisplay(fd, "I %08x 0", {p_iaddr, 2'b00});
+            end
+            if ((p_dre || p_dwe != 0) && main.cpu_dbus[0].ready && (p_daddr[31:28] == 4 || p_daddr[31:28] == 5 || p_daddr[31])) begin
+                $fdisplay(fd, "%s %08x %x", p_dwe != 0 ? "W" : "R", {p_daddr, 2'b00}, p_dwe);
+            end
+            if (pmb.shdn) begin
+                $fclose(fd);
+            end
+        end
+    end endgenerate
+    
+    always @(posedge clk) begin
+        // Power management bus.
+        if (pmb.shdn) begin $display("PMU poweroff"); $finish; end
+        if (pmb.rst) rst <= 1;
+        else if (rst) rst <= 0;
+    end
+endmodule
@@ -0,0 +1,22 @@
+
+#include "verilated.h"
+#include "Vfetch_top.h"
+
+int main(int argc, char **argv) {
+    // Create contexts.
+    VerilatedContext *contextp = new VerilatedContext;
+    contextp->commandArgs(argc, argv);
+    Vfetch_top       *top      = new Vfetch_top{contextp};
+
+    // Run until the whole program has been fetched.
+    for (int i = 0; i <= 100000 && !contextp->gotFinish(); i++) {
+        top->clk ^= 1;
+        top->eval();
+    }
+    if (!contextp->gotFinish()) {
+        printf("Timed out\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+`include "boa_defines.svh"
+
+module fetch_top#(
+    // Number of words in the IF L0 instruction buffer.
+    parameter l0_depth = 0
+)(
+    input  logic clk
+);
+    `include "fetch.svh"
+    
+    // Hold reset for the first cycle.
+    logic rst = 1;
+    always @(posedge clk) rst <= 0;
+    
+    // Program memory with a latency of one cycle.
+    boa_mem_bus pbus();
+    assign pbus.ready = 1;
+    always @(posedge clk) begin
+        pbus.rdata <= pbus.addr[31:2] < fetch_len ? fetch[pbus.addr[31:2]] : 32'h0001_0001;
+    end
+    
+    boa_pmp_bus pmp();
+    boa_pmp_stub pmp_stub(pmp);
+    
+    // IF under test; never stalled or redirected.
+    logic       q_valid;
+    logic[31:1] q_pc;
+    logic[31:0] q_insn;
+    logic[31:1] q_pred_pc;
+    logic       q_trap;
+    logic[3:0]  q_cause;
+    boa_stage_if#(.entrypoint(0), .l0_depth(l0_depth)) st_if(
+        clk, rst, 0, 3,
+        pbus, pmp,
+        q_valid, q_pc, q_insn, q_pred_pc, q_trap, q_cause,
+        0,
+        0, 'bx, 0, 'bx, 'bx,
+        0, 0, 'bx,
+        0, 'bx, 0, 'bx,
+        0, 0
+    );
+    
+    // Throughput measurement.
+    // Cycles are counted from the first instruction; every cycle after it must deliver one.
+    integer cycles     = 0;
+    integer insns      = 0;
+    integer misaligned = 0;
+    always @(posedge clk) begin
+        if (!rst && q_valid && {q_pc, 1'b0} >= fetch_len * 4) begin
+            $display("L0 depth %0d: fetched %0d instructions (%0d misaligned 32-bit) in %0d cycles", l0_depth, insns, misaligned, cycles);
+            if (cycles != insns) begin
+                $error("L0 depth %0d: %0d bubbles", l0_depth, cycles - insns);
+            end
+            $finish;
+        end else if (!rst && (q_valid || insns != 0)) begin
+            if (!q_valid) begin
+                $error("L0 depth %0d: bubble after %0d instructions", l0_depth, insns);
+            end
+            cycles     <= cycles + 1;
+            insns      <= insns + q_valid;
+            misaligned <= misaligned + (q_valid && q_pc[1] && q_insn[1:0] == 2'b11);
+        end
+    end
+endmodule
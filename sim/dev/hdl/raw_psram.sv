@@ -0,0 +1,87 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Simulated QSPI (QPI) or octal PSRAM using single data rate transfers.
+// Inputs are sampled on the rising edge of sclk, read data is driven on the falling edge.
+// In QSPI mode, the PSRAM starts in SPI mode, where only the command that enters QPI mode (0x35) is recognized.
+module raw_psram#(
+    // Address width of the PSRAM in bytes.
+    parameter  alen     = 8,
+    // Number of data lines, 4 (QSPI) or 8 (octal).
+    parameter  io_width = 4,
+    // Number of wait clocks between the address and the read data.
+    parameter  rd_wait  = 6,
+    // Read command.
+    parameter  rd_cmd   = 8'heb,
+    // Write command.
+    parameter  wr_cmd   = 8'h38,
+    // Number of clocks per byte.
+    localparam ppb      = 8 / io_width,
+    // Number of clocks for the command and address.
+    localparam hdr      = 32 / io_width,
+    // Storage depth.
+    localparam depth    = 1 << alen
+)(
+    // Chip select, active low.
+    input  logic                ce_n,
+    // PSRAM clock.
+    input  logic                sclk,
+    // Data input.
+    input  logic[io_width-1:0]  sio_in,
+    // Data output.
+    output logic[io_width-1:0]  sio_out
+);
+    // Data storage.
+    logic[7:0]          storage[depth];
+    // In QPI or octal mode.
+    logic               qpi = io_width != 4;
+    // Rising edges of sclk in the current transaction.
+    integer             rcnt;
+    // Command and address shift register.
+    logic[31:0]         hdr_sh;
+    // Write data shift register.
+    logic[7:0]          wbuf;
+    
+    // Input logic.
+    always @(posedge sclk or posedge ce_n) begin
+        integer idx;
+        logic[7:0] wbyte;
+        if (ce_n) begin
+            // End of transaction.
+            rcnt <= 0;
+        end else if (!qpi) begin
+            // SPI mode.
+            rcnt   <= rcnt + 1;
+            hdr_sh <= {hdr_sh[30:0], sio_in[0]};
+            if (rcnt == 7 && {hdr_sh[6:0], sio_in[0]} == 8'h35) begin
+                qpi <= 1;
+            end
+        end else begin
+            // QPI or octal mode.
+            rcnt <= rcnt + 1;
+            if (rcnt < hdr) begin
+                hdr_sh <= {hdr_sh, sio_in};
+            end else if (hdr_sh[31:24] == wr_cmd) begin
+                idx   = rcnt - hdr;
+                wbyte = 8'({wbuf, sio_in});
+                wbuf <= wbyte;
+                if (idx % ppb == ppb - 1) begin
+                    storage[(hdr_sh[23:0] + idx / ppb) % depth] <= wbyte;
+                end
+            end
+        end
+    end
+    
+    // Output logic.
+    always @(negedge sclk) begin
+        integer idx;
+        if (!ce_n && qpi && rcnt >= hdr + rd_wait && hdr_sh[31:24] == rd_cmd) begin
+            idx     = rcnt - hdr - rd_wait;
+            sio_out <= storage[(hdr_sh[23:0] + idx / ppb) % depth] >> ((ppb - 1 - idx % ppb) * io_width);
+        end
+    end
+endmodule
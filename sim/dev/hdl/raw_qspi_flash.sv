@@ -0,0 +1,122 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Simulated QSPI flash that supports only fast read quad I/O, including continuous read mode.
+// Inputs are sampled on the rising edge of sclk, read data is driven on the falling edge.
+// Continuous read mode is entered or exited by the mode bits of a read; while in it, transactions start with the address.
+module raw_qspi_flash#(
+    // Address width of the flash in bytes.
+    parameter  alen         = 8,
+    // Image file, if any.
+    // The file must contain 32-bit little-endian hexadecimal words seperated by commas; the rest of the flash is erased.
+    parameter  string init_file = "",
+    // Number of dummy clocks between the mode bits and the read data.
+    parameter  dummy        = 4,
+    // Read command.
+    parameter  rd_cmd       = 8'heb,
+    // Storage depth.
+    localparam depth        = 1 << alen
+)(
+    // Chip select, active low.
+    input  logic            ce_n,
+    // Flash clock.
+    input  logic            sclk,
+    // Data input.
+    input  logic[3:0]       sio_in,
+    // Data output.
+    output logic[3:0]       sio_out
+);
+    `include "boa_fileio.svh"
+    
+    // Data storage.
+    logic[7:0]          storage[depth];
+    // In continuous read mode for the current transaction.
+    logic               xip      = 0;
+    // In continuous read mode after the current transaction.
+    logic               xip_next = 0;
+    // Rising edges of sclk in the current transaction.
+    integer             rcnt;
+    // Command shift register.
+    logic[7:0]          cmd;
+    // Address and mode bits shift register.
+    logic[31:0]         hdr_sh;
+    // The current transaction is a read.
+    wire                rd       = xip || cmd == rd_cmd;
+    // Number of clocks before the read data.
+    wire [5:0]          hdr      = (xip ? 0 : 8) + 8 + dummy;
+    
+    // Initial value in simulation.
+    initial begin
+        integer i, fd, ord, waddr;
+        logic[31:0] tmp;
+        string data;
+        for (i = 0; i < depth; i = i + 1) begin
+            storage[i] = 8'hff;
+        end
+        
+        fd = init_file != "" ? $fopen(init_file, "r") : 0;
+        if (fd) begin
+            $fclose(fd);
+            $display("Loading flash image at %s", init_file);
+            data  = boa_load_file(init_file);
+            tmp   = 0;
+            waddr = 0;
+            for (i = 0; i < data.len(); i = i + 1) begin
+                ord = data.getc(i);
+                if (ord >= 8'h30 && ord <= 8'h39) begin
+                    tmp = tmp << 4;
+                    tmp = tmp | ord[3:0];
+                end else if (ord >= 8'h41 && ord <= 8'h46) begin
+                    tmp = tmp << 4;
+                    tmp = tmp | ord - 8'h41 + 8'h0A;
+                end else if (ord >= 8'h61 && ord <= 8'h66) begin
+                    tmp = tmp << 4;
+                    tmp = tmp | ord - 8'h61 + 8'h0A;
+                end else if (ord == 8'h2C) begin
+                    {storage[waddr*4+3], storage[waddr*4+2], storage[waddr*4+1], storage[waddr*4]} = tmp;
+                    waddr = waddr + 1;
+                    tmp = 0;
+                end else if (ord > 32) begin
+                    $display("Error: Unexpected character '%s'", ord);
+                    $finish;
+                end
+            end
+            {storage[waddr*4+3], storage[waddr*4+2], storage[waddr*4+1], storage[waddr*4]} = tmp;
+            $display("Loaded %d words", waddr+1);
+        end
+    end
+    
+    // Input logic.
+    always @(posedge sclk or posedge ce_n) begin
+        if (ce_n) begin
+            // End of transaction.
+            rcnt <= 0;
+            xip  <= xip_next;
+        end else begin
+            rcnt <= rcnt + 1;
+            if (!xip && rcnt < 8) begin
+                // Command in SPI mode.
+                cmd    <= {cmd[6:0], sio_in[0]};
+            end else if (rd && rcnt < hdr - dummy) begin
+                // Address and mode bits.
+                hdr_sh <= {hdr_sh[27:0], sio_in};
+                if (rcnt == hdr - dummy - 1) begin
+                    xip_next <= hdr_sh[1:0] == 2'b10;
+                end
+            end
+        end
+    end
+    
+    // Output logic.
+    always @(negedge sclk) begin
+        integer idx;
+        if (!ce_n && rd && rcnt >= hdr) begin
+            idx     = rcnt - hdr;
+            sio_out <= storage[(hdr_sh[31:8] + idx / 2) % depth] >> ((1 - idx % 2) * 4);
+        end
+    end
+endmodule
@@ -0,0 +1,54 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Simulated zero-latency 8, 16, 32 or 64-bit asynchronous SRAM with byte enables.
+module raw_sram_wide#(
+    // Address width of the SRAM in bytes.
+    parameter  alen   = 8,
+    // Data width of the SRAM, 8, 16, 32 or 64.
+    parameter  width  = 16,
+    // Number of bytes per access.
+    localparam bpp    = width / 8,
+    // Number of byte address bits per access.
+    localparam bshift = $clog2(bpp),
+    // Storage depth.
+    localparam depth  = 1 << (alen - bshift)
+)(
+    // Write clock.
+    input  logic                clk,
+    
+    // Read enable.
+    input  logic                re,
+    // Write enable.
+    input  logic                we,
+    // Byte enables.
+    input  logic[bpp-1:0]       be,
+    // Address.
+    input  logic[alen-1:bshift] addr,
+    // Write data.
+    input  logic[width-1:0]     wdata,
+    // Read data.
+    output logic[width-1:0]     rdata
+);
+    genvar x;
+    
+    // Data storage.
+    logic[width-1:0] storage[depth];
+    
+    // Read access logic.
+    assign rdata = re && !we ? storage[addr] : 'bz;
+    // Write access logic.
+    generate
+        for (x = 0; x < bpp; x = x + 1) begin
+            always @(posedge clk) begin
+                if (we && be[x]) begin
+                    storage[addr][x*8+7:x*8] <= wdata[x*8+7:x*8];
+                end
+            end
+        end
+    endgenerate
+endmodule
@@ -0,0 +1,57 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// Simulated 32-bit pipelined synchronous SRAM with byte enables.
+// The address and read data are both registered, so read data is valid two cycles after the address.
+module raw_ssram#(
+    // Address width of the SRAM in bytes.
+    parameter  alen  = 8,
+    // Storage depth.
+    localparam depth = 1 << (alen - 2)
+)(
+    // SRAM clock.
+    input  logic            clk,
+    
+    // Read enable.
+    input  logic            re,
+    // Write enable.
+    input  logic            we,
+    // Byte enables.
+    input  logic[3:0]       be,
+    // Address.
+    input  logic[alen-1:2]  addr,
+    // Write data.
+    input  logic[31:0]      wdata,
+    // Read data.
+    output logic[31:0]      rdata
+);
+    genvar x;
+    
+    // Data storage.
+    logic[31:0]     storage[depth];
+    // Registered read enable.
+    logic           r_re;
+    // Registered address.
+    logic[alen-1:2] r_addr;
+    
+    // Read access logic.
+    always @(posedge clk) begin
+        r_re   <= re && !we;
+        r_addr <= addr;
+        rdata  <= r_re ? storage[r_addr] : 'bx;
+    end
+    // Write access logic.
+    generate
+        for (x = 0; x < 4; x = x + 1) begin
+            always @(posedge clk) begin
+                if (we && be[x]) begin
+                    storage[addr][x*8+7:x*8] <= wdata[x*8+7:x*8];
+                end
+            end
+        end
+    endgenerate
+endmodule
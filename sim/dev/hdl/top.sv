@@ -5,7 +5,10 @@
 
 
 
-module top(
+module top#(
+    // Boot straight from the external flash instead of the boot ROM.
+    parameter bit boot_flash = 0
+)(
     input  logic clk,
     output logic tx,
     input  logic rx
@@ -24,6 +27,7 @@ module top(
     assign gpio_in = gpio_out;
     logic[31:0] randomness = $urandom();
     boa_mem_bus#(12) xmp_bus();
+    boa_mem_bus#(12) xmp_buses[2]();
     boa_mem_bus#(xm_alen) extrom_bus();
     boa_mem_bus#(xm_alen) extram_bus();
     pmu_bus pmb();
@@ -34,6 +38,7 @@ module top(
     // Main microcontroller device.
     main#(
         .rom_file({boa_parentdir(`__FILE__), "/../obj_dir/rom.mem"}),
+        .entrypoint(boot_flash ? 32'h8000_0000 : 32'h4000_0000),
         .uart_buf(65536),
         .uart_div(4),
         .is_simulator(1),
@@ -50,8 +55,11 @@ module top(
     );
     
     // Additional peripherals.
+    boa_mem_overlay#(.mems(2)) xmp_ovl(xmp_bus, xmp_buses);
+    // Extrom size device.
+    boa_peri_readable#('h500) xr_size(clk, rst, xmp_buses[0], 32'b1 << xm_alen);
     // Extmem size device.
-    boa_peri_readable#('h600) xm_size(clk, rst, xmp_bus, 32'b1 << xm_alen);
+    boa_peri_readable#('h600) xm_size(clk, rst, xmp_buses[1], 32'b1 << xm_alen);
     
     // Simulated external SRAM.
     logic               sram_re;
@@ -62,9 +70,18 @@ module top(
     raw_sram#(xm_alen) sram(clk, sram_re, sram_we, sram_addr, sram_wdata, sram_rdata);
     boa_extmem_sram#(xm_alen) sram_ctl(clk, rst, extram_bus, sram_re, sram_we, sram_addr, sram_wdata, sram_rdata);
     
-    // External ROM stub.
-    assign extrom_bus.ready = 1;
-    assign extrom_bus.rdata = 0;
+    // Simulated external QSPI flash, for executing in place.
+    logic               flash_ce_n;
+    logic               flash_sclk;
+    logic               flash_oe;
+    logic[3:0]          flash_sio_out;
+    logic[3:0]          flash_sio_in;
+    raw_qspi_flash#(xm_alen, {boa_parentdir(`__FILE__), "/../obj_dir/flash.mem"}) flash(
+        flash_ce_n, flash_sclk, flash_sio_out, flash_sio_in
+    );
+    boa_extmem_qspi_flash#(xm_alen) flash_ctl(
+        clk, rst, extrom_bus, flash_ce_n, flash_sclk, flash_oe, flash_sio_out, flash_sio_in
+    );
     
     always @(posedge clk) begin
         // Create new randomness.
@@ -3,7 +3,14 @@
 
 `timescale 1ns/1ps
 
-module top(
+module top#(
+    // Use the iterative divider.
+    parameter bit div_iterative = 0,
+    // Number of store buffer entries, 0 to disable.
+    parameter int sbuf_depth    = 0,
+    // Support misaligned loads and stores in hardware.
+    parameter bit misaligned    = 0
+)(
     input  logic        clk,
     output logic        is_ecall,
     output logic        is_ebreak,
@@ -51,20 +58,30 @@ module top(
     
     // The boa CPU core.
     logic fence_rl, fence_aq, fence_i, amo_en;
+    logic cmo_inval, cmo_clean, cmo_prefetch;
+    logic[31:0] cmo_addr;
     boa_amo_bus resv_bus();
     boa_amo_term resv_term(resv_bus);
     boa32_cpu#(
         .entrypoint(32'h8000_0000),
         .misa_we(0),
         .has_m(1),
+        .div_iterative(div_iterative),
         .has_a(1),
-        .has_c(1)
+        .has_c(1),
+        .sbuf_depth(sbuf_depth),
+        .misaligned(misaligned),
+        .has_zba(1),
+        .has_zbb(1),
+        .has_zbs(1)
     ) cpu (
         clk, clk, rst,
         pbus, dbus,
         fence_rl, fence_aq, fence_i,
+        cmo_inval, cmo_clean, cmo_prefetch, cmo_addr, 0,
         amo_en, resv_bus,
-        0
+        0, 0,
+        0, 0
     );
 endmodule
 
@@ -27,6 +27,11 @@ def compile_test(test):
     isa = os.environ.get("ISA",     "rv32imac_zicsr_zifencei")
     abi = os.environ.get("ABI",     "ilp32")
     
+    # Bit-manipulation tests are compiled with their own extension added.
+    suite = Path(test).parent.name
+    if suite.startswith("rv32uzb"):
+        isa += "_" + suite[5:]
+    
     Path("build/"+test).parent.mkdir(parents=True, exist_ok=True)
     
     res = subprocess.run([cc, "-march="+isa, "-mabi="+abi, "-Iriscv-tests/env/p", "-Iriscv-tests/isa/macros/scalar", "-o", "build/"+test+".elf", test, "-nostartfiles", "-nodefaultlibs", "-nostdlib", "-Tlinker.ld"], stdout=subprocess.PIPE)
@@ -51,8 +56,9 @@ def compile_test(test):
 
 
 
-def run_test(test, debug=False):
+def run_test(test, debug=False, config={}):
     env = os.environ.copy()
+    env.update(config)
     env["PROG"]=os.getcwd()+"/build/"+test+".mem"
     res = subprocess.run(["make", "run"], env=env, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
     if res.returncode != 0:
@@ -73,7 +79,14 @@ if __name__ == "__main__":
         debug = False
     else:
         print("tests.py [debug]")
+    # Alternative CPU configurations and the tests that are run again with them.
+    configs = [
+        ({"DIV_ITERATIVE": "1"}, list_tests("tests-div.txt")),
+        ({"SBUF_DEPTH": "2", "MISALIGNED": "1"}, list_tests("tests.txt") + list_tests("tests-misaligned.txt")),
+    ]
     tests = list_tests("tests.txt")
+    for config, extra in configs:
+        tests += [test for test in extra if test not in tests]
     compiled = []
     notcomp = 0
     notrun  = 0
@@ -84,12 +97,16 @@ if __name__ == "__main__":
             compiled += [test]
         else:
             notcomp += 1
-    for test in compiled:
-        print("Running test " + test)
-        if run_test(test, debug):
-            print("\033[1F\033[2K",end="")
-        else:
-            notrun += 1
+    runs = [({}, list_tests("tests.txt"))] + configs
+    for config, extra in runs:
+        for test in extra:
+            if test not in compiled:
+                continue
+            print("Running test " + test + "".join(" " + k + "=" + v for k, v in config.items()))
+            if run_test(test, debug, config):
+                print("\033[1F\033[2K",end="")
+            else:
+                notrun += 1
     if notcomp:
         print("{} test{} failed to compile".format(notcomp, "s" if notcomp != 1 else ""))
     if notrun:
@@ -0,0 +1,22 @@
+
+#include "verilated.h"
+#include "Vcheck.h"
+
+int main(int argc, char **argv) {
+    // Create contexts.
+    VerilatedContext *contextp = new VerilatedContext;
+    contextp->commandArgs(argc, argv);
+    Vcheck          *top      = new Vcheck{contextp};
+
+    // Run until all patterns are done.
+    for (long i = 0; i <= 10000000 && !contextp->gotFinish(); i++) {
+        top->clk ^= 1;
+        top->eval();
+    }
+    if (!contextp->gotFinish()) {
+        printf("Timed out\n");
+        return 1;
+    }
+
+    return 0;
+}
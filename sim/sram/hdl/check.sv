@@ -0,0 +1,176 @@
+
+// Copyright © 2024, Julian Scheffers, see LICENSE for more information
+
+`timescale 1ns/1ps
+
+
+
+// External memory controller check: fills the memory with bursts, then does random single accesses and bursts,
+// checks the data read against a reference and reports the cycle count.
+module check#(
+    // Controller under test: "sram8", "sram16", "sram32", "ssram", "psram4" or "psram8".
+    parameter string  ctl       = "sram16",
+    // Number of random accesses and bursts.
+    parameter integer accesses  = 4096
+)(
+    input logic clk
+);
+    logic rst = 1;
+    always @(posedge clk) rst <= 0;
+    
+    // 4 KiB of external memory.
+    localparam alen  = 12;
+    localparam words = 1 << (alen - 2);
+    boa_mem_bus#(alen) bus();
+    
+    // Controller and simulated memory.
+    generate
+        if (ctl == "sram8") begin: sram8
+            logic           re, we;
+            logic[alen-1:0] addr;
+            logic[7:0]      wdata, rdata;
+            boa_extmem_sram#(alen) xm_ctl(clk, rst, bus, re, we, addr, wdata, rdata);
+            raw_sram#(alen) mem(clk, re, we, addr, wdata, rdata);
+        end else if (ctl == "sram16" || ctl == "sram32") begin: sram_wide
+            localparam width = ctl == "sram16" ? 16 : 32;
+            localparam bpp   = width / 8;
+            logic                       re, we;
+            logic[bpp-1:0]              be;
+            logic[alen-1:$clog2(bpp)]   addr;
+            logic[width-1:0]            wdata, rdata;
+            boa_extmem_sram_wide#(alen, width) xm_ctl(clk, rst, bus, re, we, be, addr, wdata, rdata);
+            raw_sram_wide#(alen, width) mem(clk, re, we, be, addr, wdata, rdata);
+        end else if (ctl == "ssram") begin: ssram
+            logic           re, we;
+            logic[3:0]      be;
+            logic[alen-1:2] addr;
+            logic[31:0]     wdata, rdata;
+            boa_extmem_ssram#(alen) xm_ctl(clk, rst, bus, re, we, be, addr, wdata, rdata);
+            raw_ssram#(alen) mem(clk, re, we, be, addr, wdata, rdata);
+        end else if (ctl == "psram4" || ctl == "psram8") begin: psram
+            localparam io_width = ctl == "psram4" ? 4 : 8;
+            logic               ce_n, sclk, oe;
+            logic[io_width-1:0] sio_out, sio_in;
+            boa_extmem_psram#(alen, io_width) xm_ctl(clk, rst, bus, ce_n, sclk, oe, sio_out, sio_in);
+            raw_psram#(alen, io_width) mem(ce_n, sclk, sio_out, sio_in);
+        end
+    endgenerate
+    
+    // Expected memory contents.
+    logic[31:0] model[words];
+    
+    // Access generator.
+    // Phase 0: fill the memory with 16-beat write bursts.
+    // Phase 1: random reads, writes with random byte enables, idle cycles and read and write bursts.
+    // Phase 2: wait for the last access to complete.
+    integer         phase   = 0;
+    integer         issued  = 0;
+    integer         cycles  = 0;
+    integer         fill    = 0;
+    // Access to present next.
+    logic           n_re    = 0;
+    logic[3:0]      n_we    = 0;
+    logic[alen-1:2] n_addr;
+    logic[31:0]     n_wdata;
+    logic[3:0]      n_blen  = 0;
+    logic           n_bwrap = 0;
+    logic           n_blast = 1;
+    // Beats of the current burst left after the next access.
+    integer         n_left  = 0;
+    // Access presented last cycle.
+    logic           p_re    = 0;
+    logic[3:0]      p_we    = 0;
+    logic[alen-1:2] p_addr;
+    logic[31:0]     p_wdata;
+    logic[3:0]      p_blen;
+    logic           p_bwrap;
+    logic           p_blast;
+    
+    // The next access is presented when the previous one completes, otherwise the previous one is held.
+    assign bus.re    = !rst && (bus.ready ? n_re    : p_re);
+    assign bus.we    = rst ? 0 : bus.ready ? n_we   : p_we;
+    assign bus.addr  = bus.ready ? n_addr  : p_addr;
+    assign bus.wdata = bus.ready ? n_wdata : p_wdata;
+    assign bus.blen  = bus.ready ? n_blen  : p_blen;
+    assign bus.bwrap = bus.ready ? n_bwrap : p_bwrap;
+    assign bus.blast = bus.ready ? n_blast : p_blast;
+    
+    always @(posedge clk) begin
+        integer   i;
+        logic[31:0] r;
+        if (!rst) begin
+            cycles  <= cycles + 1;
+            p_re    <= bus.re;
+            p_we    <= bus.we;
+            p_addr  <= bus.addr;
+            p_wdata <= bus.wdata;
+            p_blen  <= bus.blen;
+            p_bwrap <= bus.bwrap;
+            p_blast <= bus.blast;
+            
+            if (bus.ready && p_re && bus.rdata != model[p_addr]) begin
+                $error("Read %x from %x, expected %x", bus.rdata, p_addr << 2, model[p_addr]);
+            end else if (bus.ready && p_we != 0) begin
+                for (i = 0; i < 4; i = i + 1) begin
+                    if (p_we[i]) model[p_addr][i*8 +: 8] <= p_wdata[i*8 +: 8];
+                end
+            end
+            
+            if (phase == 2 && bus.ready && !p_re && p_we == 0 && !bus.re && bus.we == 0) begin
+                $display("%s: fill %0d cycles, random %0d cycles", ctl, fill, cycles - fill);
+                $finish;
+            end
+            
+            if (bus.ready) begin
+                // Generate the access after the one presented.
+                r       = $urandom();
+                n_wdata <= $urandom();
+                if (n_left != 0) begin
+                    // Next beat of a burst.
+                    n_addr  <= n_bwrap ? (n_addr & ~n_blen) | ((n_addr + 1) & n_blen) : n_addr + 1;
+                    n_blast <= n_left == 1;
+                    n_left  <= n_left - 1;
+                end else if (phase == 0) begin
+                    // Fill burst.
+                    n_re    <= 0;
+                    n_we    <= 4'b1111;
+                    n_addr  <= issued * 16;
+                    n_blen  <= 15;
+                    n_bwrap <= 0;
+                    n_blast <= 0;
+                    n_left  <= 15;
+                    issued  <= issued + 1;
+                    if (issued == words / 16 - 1) begin
+                        phase   <= 1;
+                        issued  <= 0;
+                    end
+                end else if (phase == 1 && issued == 0 && fill == 0) begin
+                    // Let the fill complete before timing the random accesses.
+                    n_re    <= 0;
+                    n_we    <= 0;
+                    n_blen  <= 0;
+                    fill    <= cycles + 1;
+                    issued  <= 1;
+                end else if (phase == 1) begin
+                    // Random access.
+                    n_re    <= r[2:0] <= 2 || r[2:0] == 4 || r[2:0] == 7;
+                    n_we    <= r[2:0] == 3 ? (r[7:4] != 0 ? r[7:4] : 4'b0001) : r[2:0] == 5 ? 4'b1111 : 4'b0000;
+                    n_addr  <= r[31:32-alen+2];
+                    n_blen  <= r[2:0] == 4 || r[2:0] == 5 ? (r[9:8] == 0 ? 3 : r[9:8] == 1 ? 7 : 15) : 0;
+                    n_bwrap <= r[10];
+                    n_blast <= !(r[2:0] == 4 || r[2:0] == 5);
+                    n_left  <= r[2:0] == 4 || r[2:0] == 5 ? (r[9:8] == 0 ? 3 : r[9:8] == 1 ? 7 : 15) : 0;
+                    issued  <= issued + 1;
+                    if (issued == accesses) begin
+                        phase   <= 2;
+                    end
+                end else begin
+                    // Done.
+                    n_re    <= 0;
+                    n_we    <= 0;
+                    n_blen  <= 0;
+                end
+            end
+        end
+    end
+endmodule
@@ -23,6 +23,9 @@ module top(
     boa_extmem_sram#(sram_alen) xm_ctl(clk, 0, bus, xm_re, xm_we, xm_addr, xm_wdata, xm_rdata);
     
     assign xm_rdata = xm_addr;
+    assign bus.blen  = 0;
+    assign bus.bwrap = 0;
+    assign bus.blast = 1;
     
     always @(*) begin
         if (cycle <= 3) begin